@@ -0,0 +1,920 @@
+//Micro-benchmarks for the shell internals - run with './bench <name>' or './bench' for all of them.
+#define EGGSHELL_NO_MAIN
+#include "main.c"
+#include <time.h>
+#include <malloc.h>
+
+#define REPL_HEAP_LIMIT (64 * 1024) //Most bytes the heap may grow by over the long run of 'bench repl'.
+#define REPL_RSS_LIMIT 512 //Most KB the peak memory may grow by over it.
+
+bool failed = false; //Set by a benchmark whose check failed, so the program exits with 1.
+
+//Returns the current time in seconds.
+double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//Returns the peak resident memory of the process in KB.
+long peak_memory(){
+    char line[256];
+    long peak = -1;
+    FILE *f = fopen("/proc/self/status", "r");
+    while(f != NULL && fgets(line, sizeof(line), f) != NULL){
+        if(strncmp(line, "VmHWM:", 6) == 0)
+            peak = atol(line + 6);
+    }
+    if(f != NULL)
+        fclose(f);
+    return peak;
+}
+
+//Deletes every variable in the store and frees its memory.
+void clear_vars(){
+    free(variables);
+    free(var_index);
+    free_arena(&var_arena);
+    variables = NULL;
+    var_index = NULL;
+    VAR_SIZE = VAR_CAPACITY = VAR_COUNT = VAR_INDEX_SIZE = 0;
+    //Their environment strings go too (the array is kept, so launched programs always get one).
+    for(int i=0;i<ENV_COUNT;i++)
+        free(envp[i]);
+    ENV_COUNT = 0;
+    if(envp != NULL)
+        envp[0] = NULL;
+}
+
+//Tokenizes, parses and executes a line, as the terminal does.
+int run_line(char *line){
+    TOKENS tokens = {0};
+    SCRIPT script = {0};
+    lex_line(line, &tokens);
+    parse_tokens(&tokens, &script);
+    int status = execute_script(&script);
+    free_arena(&script.arena);
+    free_tokens(&tokens);
+    return status;
+}
+
+//Runs a line 'runs' times with stdout sent to /dev/null, returning the average time in seconds.
+double time_line(char *line, int runs){
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO), null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    double t = now();
+    for(int i=0;i<runs;i++)
+        run_line(line);
+    t = (now() - t) / runs;
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(null);
+    return t;
+}
+
+/* --------------------- VARIABLES -------------------- */
+
+//Measures assignments and lookups with 10, 1k and 100k variables in the store.
+void bench_vars(){
+    int sizes[] = {10, 1000, 100000};
+    int lookups = 1000000;
+    char name[64], value[64];
+    printf("%-10s %18s %18s %18s\n", "variables", "insert (ns/op)", "assign (ns/op)", "lookup (ns/op)");
+    for(int s=0;s<sizeof(sizes)/sizeof(int);s++){
+        int n = sizes[s];
+        clear_vars();
+        //Creating n new variables.
+        double t = now();
+        for(int i=0;i<n;i++){
+            sprintf(name, "VAR%d", i);
+            sprintf(value, "%d", i);
+            modify_var(name, value);
+        }
+        double insert = (now() - t) / n * 1e9;
+        //Re-assigning existing variables.
+        t = now();
+        for(int i=0;i<lookups;i++){
+            sprintf(name, "VAR%d", i % n);
+            modify_var(name, "x");
+        }
+        double assign = (now() - t) / lookups * 1e9;
+        //Looking up existing variables.
+        long found = 0;
+        t = now();
+        for(int i=0;i<lookups;i++){
+            sprintf(name, "VAR%ld", (i * 7919L) % n);
+            found += return_var_value(name) != NULL;
+        }
+        double lookup = (now() - t) / lookups * 1e9;
+        if(found != lookups)
+            fprintf(stderr, "Error -- %ld of %d lookups failed.\n", lookups - found, lookups);
+        printf("%-10d %18.1f %18.1f %18.1f\n", n, insert, assign, lookup);
+    }
+    clear_vars();
+}
+
+//Measures expanding a word with three variables ('$VAR0-${VAR1}/$VAR2 tail') with 10, 1k and 100k variables in the store.
+void bench_expand(){
+    int sizes[] = {10, 1000, 100000};
+    int runs = 1000000;
+    char name[64];
+    ARENA arena = {0};
+    EXPANSION expansion = {&arena, NULL, 0};
+    printf("%-10s %18s\n", "variables", "expand (ns/word)");
+    for(int s=0;s<sizeof(sizes)/sizeof(int);s++){
+        int n = sizes[s];
+        clear_vars();
+        for(int i=0;i<n;i++){
+            sprintf(name, "VAR%d", i);
+            modify_var(name, "value");
+        }
+        double t = now();
+        for(int i=0;i<runs;i++)
+            expand_word("$VAR0-${VAR1}/$VAR2 tail", &expansion, 0);
+        t = (now() - t) / runs * 1e9;
+        if(strcmp(expansion.text, "value-value/value tail") != 0)
+            fprintf(stderr, "Error -- wrong expansion '%s'.\n", expansion.text);
+        printf("%-10d %18.1f\n", n, t);
+    }
+    free_arena(&arena);
+    clear_vars();
+}
+
+//Sources a script defining 50k variables and compares the store's memory with fixed 2 KB records.
+void bench_memory(){
+    int n = 50000;
+    char path[] = "/tmp/eggshell_bench_XXXXXX";
+    int fd = mkstemp(path);
+    FILE *f = fdopen(fd, "w");
+    for(int i=0;i<n;i++)
+        fprintf(f, "VAR%d=value%d\n", i, i);
+    fclose(f);
+    clear_vars();
+    char *args[] = {"source", path, NULL};
+    double t = now();
+    source_comm(args);
+    double elapsed = now() - t;
+    unlink(path);
+    //Memory used by the arena blocks, the variable array and the hash index.
+    size_t arena = 0;
+    for(ARENA_BLOCK *block = var_arena.blocks; block != NULL; block = block->next)
+        arena += sizeof(ARENA_BLOCK) + block->size;
+    size_t store = arena + VAR_CAPACITY * sizeof(VARIABLE) + VAR_INDEX_SIZE * sizeof(int);
+    //The old layout kept two MAX_SIZE buffers per variable.
+    size_t fixed = (size_t)VAR_COUNT * 2 * MAX_SIZE;
+    printf("variables defined:        %d (sourced in %.3f s)\n", VAR_COUNT, elapsed);
+    printf("fixed 2 KB records:       %zu bytes\n", fixed);
+    printf("arena + array + index:    %zu bytes (arena %zu, live strings %zu)\n", store, arena, var_arena.used - var_arena.garbage);
+    printf("saved:                    %zu bytes (%.1fx smaller)\n", fixed - store, (double)fixed / store);
+    clear_vars();
+}
+
+//Feeds 1M commands to the terminal loop (after a 100k-command warm-up) and shows how much its heap and memory grew.
+void bench_repl(){
+    char *commands[] = {"X=value", "print $X and more words", "print y > /dev/null", "unset X"};
+    int counts[] = {100000, 1000000};
+    long peak = 0;
+    size_t heap = 0;
+    for(int c=0;c<2;c++){
+        char path[] = "/tmp/eggshell_bench_XXXXXX";
+        FILE *f = fdopen(mkstemp(path), "w");
+        for(int i=0;i<counts[c];i++)
+            fprintf(f, "%s\n", commands[i % 4]);
+        fclose(f);
+        //Runs the loop with the script as stdin and stdout sent to /dev/null.
+        fflush(stdout);
+        int saved_in = dup(STDIN_FILENO), saved_out = dup(STDOUT_FILENO);
+        int in = open(path, O_RDONLY), null = open("/dev/null", O_WRONLY);
+        dup2(in, STDIN_FILENO);
+        dup2(null, STDOUT_FILENO);
+        double t = now();
+        start();
+        t = now() - t;
+        fflush(stdout);
+        dup2(saved_in, STDIN_FILENO);
+        dup2(saved_out, STDOUT_FILENO);
+        clearerr(stdin);
+        close(saved_in), close(saved_out), close(in), close(null);
+        unlink(path);
+        if(c == 0){
+            peak = peak_memory();
+            heap = mallinfo2().uordblks;
+            continue;
+        }
+        //Fails if the memory grew with the number of commands after the warm-up run.
+        ssize_t heap_growth = mallinfo2().uordblks - heap;
+        long peak_growth = peak_memory() - peak;
+        printf("%d commands:             %8.0f ns/command\n", counts[c], t / counts[c] * 1e9);
+        printf("heap growth:                   %8zd bytes\n", heap_growth);
+        printf("peak memory growth:            %8ld KB\n", peak_growth);
+        if(heap_growth > REPL_HEAP_LIMIT || peak_growth > REPL_RSS_LIMIT){
+            fflush(stdout);
+            fprintf(stderr, "Error -- The memory grew past the limit (%d bytes of heap, %d KB of peak memory).\n", REPL_HEAP_LIMIT, REPL_RSS_LIMIT);
+            failed = true;
+        }
+    }
+}
+
+/* --------------------- PROCESSES -------------------- */
+
+//Measures processes started and wall time of 2- to 32-stage pipelines ('print x | cat | ... | cat').
+void bench_pipes(){
+    int runs = 20;
+    printf("%-8s %14s %22s %14s\n", "stages", "processes/run", "recursive forks/run", "ms/run");
+    for(int n=2;n<=32;n*=2){
+        char line[MAX_SIZE] = "print x";
+        for(int i=1;i<n;i++)
+            strcat(line, " | cat");
+        long forks = PROCESS_COUNT;
+        double t = time_line(line, runs);
+        //The old recursive execute_pipe() forked twice per split and launch() forked again for every 'cat'.
+        printf("%-8d %14ld %22d %14.2f\n", n, (PROCESS_COUNT - forks) / runs, 3 * n - 3, t * 1e3);
+    }
+}
+
+//Compares commands/second of /bin/true (not the internal 'true') launched with fork and with posix_spawn as the shell's heap grows.
+void bench_spawn(){
+    size_t heaps[] = {0, 256, 1024}; //MB of touched heap memory.
+    int runs = 300;
+    char *program = find_command("true");
+    printf("%-10s %16s %16s\n", "heap (MB)", "fork (cmd/s)", "spawn (cmd/s)");
+    for(int h=0;h<sizeof(heaps)/sizeof(size_t);h++){
+        //Touches every page, so a fork has to copy the page tables for all of it.
+        char *heap = malloc(heaps[h] << 20);
+        memset(heap, 1, heaps[h] << 20);
+        modify_var("LAUNCHER", "fork");
+        double forked = time_line(program, runs);
+        modify_var("LAUNCHER", "spawn");
+        double spawned = time_line(program, runs);
+        printf("%-10zu %16.0f %16.0f\n", heaps[h], 1 / forked, 1 / spawned);
+        free(heap);
+    }
+    delete_var("LAUNCHER");
+}
+
+//Launches a program with the shell's exported variables and with 1k more (the environment is not rebuilt for a launch),
+//and compares assigning an exported variable with assigning a plain one.
+void bench_export(){
+    int counts[] = {0, 1000};
+    int runs = 300, assignments = 1000000;
+    char name[64];
+    char *program = find_command("true");
+    printf("%-10s %16s\n", "exported", "launch (cmd/s)");
+    for(int c=0;c<sizeof(counts)/sizeof(int);c++){
+        for(int i=0;i<counts[c];i++){
+            sprintf(name, "EXPORTED%d", i);
+            modify_var(name, "value");
+            export_var(name);
+        }
+        printf("%-10d %16.0f\n", ENV_COUNT, 1 / time_line(program, runs));
+    }
+    modify_var("PLAIN", "value");
+    double t = now();
+    for(int i=0;i<assignments;i++)
+        modify_var("PLAIN", i & 1 ? "one" : "two");
+    double plain = (now() - t) / assignments;
+    t = now();
+    for(int i=0;i<assignments;i++)
+        modify_var("EXPORTED0", i & 1 ? "one" : "two");
+    double exported = (now() - t) / assignments;
+    run_line("seen=$(/bin/sh -c 'echo $EXPORTED999')");
+    printf("plain assignment:            %10.1f ns\n", plain * 1e9);
+    printf("exported assignment:         %10.1f ns\n", exported * 1e9);
+    printf("child sees the variables:    %10s\n", strcmp(return_var_value("seen"), "value") == 0 ? "yes" : "no");
+    for(int i=0;i<counts[1];i++){
+        sprintf(name, "EXPORTED%d", i);
+        delete_var(name);
+    }
+    delete_var("PLAIN");
+    delete_var("seen");
+}
+
+//Runs a 10k-command script and counts the exec attempts that the command hash saves over searching PATH every time.
+void bench_hash(){
+    char *names[] = {"head", "sort", "ls", "wc"};
+    char *lines[] = {"head -c 0 /dev/null", "sort /dev/null", "ls -d /", "wc -c /dev/null"};
+    int n = 10000, count = sizeof(names) / sizeof(char *), dirs = 1;
+    char *paths = return_var_value("PATH");
+    for(char *c = paths; *c != '\0'; c++)
+        dirs += *c == ':';
+    //An execvp() call tries every PATH directory up to the one holding the command.
+    long attempts = 0;
+    for(int i=0;i<count;i++){
+        char *path = search_path(names[i]);
+        size_t dir_length = strlen(path) - strlen(names[i]) - 1;
+        int tries = 1;
+        for(char *dir = paths; strlen(dir) > 0; tries++){
+            size_t length = strcspn(dir, ":");
+            if(length == dir_length && strncmp(dir, path, length) == 0)
+                break;
+            dir += dir[length] == ':' ? length + 1 : length;
+        }
+        attempts += (long)tries * (n / count);
+        free(path);
+    }
+    //Runs the script with the command hash.
+    char path[] = "/tmp/eggshell_bench_XXXXXX";
+    FILE *f = fdopen(mkstemp(path), "w");
+    for(int i=0;i<n;i++)
+        fprintf(f, "%s\n", lines[i % count]);
+    fclose(f);
+    char line[64];
+    sprintf(line, "source %s", path);
+    clear_command_hash();
+    double t = time_line(line, 1);
+    unlink(path);
+    printf("PATH directories:               %d\n", dirs);
+    printf("commands run:                   %d in %.2f s\n", n, t);
+    printf("execve calls without the hash:  %ld (%ld failed)\n", attempts, attempts - n);
+    printf("execve calls with the hash:     %d (+%d PATH searches)\n", n, HASH_COUNT);
+}
+
+//Times the logging idiom 'print ... >> log', which runs in the shell process without forking.
+void bench_redirect(){
+    int runs = 10000;
+    long processes = PROCESS_COUNT;
+    double t = time_line("print some log line >> /dev/null", runs);
+    printf("print >> log:  %8.2f us/run, %ld processes/run\n", t * 1e6, (PROCESS_COUNT - processes) / runs);
+}
+
+/* ---------------------- SCRIPTS --------------------- */
+
+//Compares sourcing a 1000-line script that is parsed every time with one whose parse tree is cached.
+void bench_source(){
+    int lines = 1000, runs = 200;
+    char path[] = "/tmp/eggshell_bench_XXXXXX";
+    FILE *f = fdopen(mkstemp(path), "w");
+    for(int i=0;i<lines;i++)
+        fprintf(f, "HOOK%d=\"value $HOOK%d\" < /dev/null\nHOOK%d=$HOOK%d\n", i % 10, i % 10, i % 10, i % 10);
+    fclose(f);
+    char *args[] = {"source", path, NULL};
+    struct stat info;
+    //Parsing the script every time (by dropping it from the cache before each run).
+    double t = now();
+    for(int i=0;i<runs;i++){
+        while(script_cache != NULL){
+            SCRIPT *next = script_cache->next;
+            free_script(script_cache);
+            script_cache = next;
+        }
+        stat(path, &info);
+        load_script(path, &info);
+    }
+    double parsed = (now() - t) / runs * 1e6;
+    //Reusing the cached parse tree.
+    t = now();
+    for(int i=0;i<runs;i++){
+        stat(path, &info);
+        load_script(path, &info);
+    }
+    double cached = (now() - t) / runs * 1e6;
+    //Executing the cached script (only assignments, so nothing forks).
+    unlink(path);
+    f = fopen(path, "w");
+    for(int i=0;i<lines;i++)
+        fprintf(f, "HOOK%d=value$HOOK%d\n", i % 10, i % 10);
+    fclose(f);
+    t = now();
+    for(int i=0;i<runs;i++){
+        for(int v=0;v<10;v++){
+            char name[16];
+            sprintf(name, "HOOK%d", v);
+            modify_var(name, "");
+        }
+        source_comm(args);
+    }
+    double executed = (now() - t) / runs * 1e6;
+    unlink(path);
+    printf("load, parsing every time:  %10.1f us/source\n", parsed);
+    printf("load, cached parse tree:   %10.1f us/source\n", cached);
+    printf("source of %d assignments:  %10.1f us/source\n", lines, executed);
+}
+
+//Sources a 64MB script of 2KB lines, which is executed while it is read, and shows how much the shell's memory grew.
+void bench_stream(){
+    int lines = 32768;
+    char path[] = "/tmp/eggshell_bench_XXXXXX", value[2048];
+    memset(value, 'x', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+    FILE *f = fdopen(mkstemp(path), "w");
+    for(int i=0;i<lines;i++)
+        fprintf(f, "LONG%d=%.*s\\\n%s\n", i % 10, 1000, value, value + 1000);
+    fclose(f);
+    long peak = peak_memory();
+    char *args[] = {"source", path, NULL};
+    double t = now();
+    source_comm(args);
+    t = now() - t;
+    unlink(path);
+    printf("%d lines of %zu bytes (continued):  %8.1f MB/s\n", lines, sizeof(value), lines * (sizeof(value) + 2) / t / 1e6);
+    printf("peak memory growth:                   %8ld KB\n", peak_memory() - peak);
+    printf("last value intact:                    %8s\n", strlen(return_var_value("LONG0")) == sizeof(value) - 1 ? "yes" : "no");
+}
+
+//Starts the shell as a subprocess running one command ('eggshell -c true') or a one-line script, as callers running it at high rates do,
+//and compares it with /bin/sh. The time is from launching the process to reaping it, so it bounds the time to the first command.
+void bench_startup(){
+    char shell[MAX_SIZE], line[2 * MAX_SIZE], path[] = "/tmp/eggshell_bench_XXXXXX";
+    int runs = 1000;
+    //The shell is built next to the benchmarks.
+    ssize_t n = readlink("/proc/self/exe", shell, sizeof(shell) - 16);
+    shell[n > 0 ? n : 0] = '\0';
+    strcpy(strrchr(shell, '/') + 1, "Source_Code");
+    int fd = mkstemp(path);
+    write_all(fd, "true\n", 5);
+    close(fd);
+    sprintf(line, "%s -c true", shell);
+    double command = time_line(line, runs);
+    sprintf(line, "%s %s", shell, path);
+    double script = time_line(line, runs);
+    double sh = time_line("/bin/sh -c true", runs);
+    unlink(path);
+    printf("eggshell -c true:            %10.3f ms\n", command * 1e3);
+    printf("eggshell script:             %10.3f ms\n", script * 1e3);
+    printf("/bin/sh -c true:             %10.3f ms\n", sh * 1e3);
+}
+
+/* ------------------ FAST COMMANDS ------------------- */
+
+//Compares commands/second of the internal 'true', 'echo', 'printf', 'test' and 'cat' with the external programs (named by their full path).
+void bench_fast(){
+    char *commands[] = {"true", "echo some words", "printf %s-%d\\n x 1", "test -f /etc/passwd", "cat /etc/passwd", "[ 1 -lt 2 ]"};
+    int runs = 500;
+    char line[MAX_SIZE];
+    printf("%-24s %18s %18s\n", "command", "internal (cmd/s)", "external (cmd/s)");
+    for(int i=0;i<sizeof(commands)/sizeof(char *);i++){
+        //Builds the line with the full path of the program, which skips the internal command.
+        char name[32];
+        sscanf(commands[i], "%31s", name);
+        char *path = find_command(strcmp(name, "[") == 0 ? "test" : name);
+        if(path == NULL)
+            continue;
+        sprintf(line, "%s%s", path, commands[i] + strlen(name));
+        if(strcmp(name, "[") == 0)
+            line[strlen(line) - 2] = '\0';
+        double internal = time_line(commands[i], runs * 20);
+        double external = time_line(line, runs);
+        printf("%-24s %18.0f %18.0f\n", commands[i], 1 / internal, 1 / external);
+    }
+}
+
+/* ------------------- CONTROL FLOW ------------------- */
+
+//Compares a 100k-iteration 'while' loop run over its parse tree with the same commands tokenized and parsed on every iteration, and times a 'for' loop.
+void bench_loops(){
+    int n = 100000;
+    char line[MAX_SIZE];
+    long processes = PROCESS_COUNT;
+    sprintf(line, "i=0; while [ $i -lt %d ]; do i=$((i + 1)); done", n);
+    double t = now();
+    run_line(line);
+    double loop = now() - t;
+    bool counted = atoi(return_var_value("i")) == n;
+    //Runs the condition and the body as separate lines, as a script without loops would.
+    modify_var("i", "0");
+    t = now();
+    for(int i=0;i<n;i++){
+        run_line("[ $i -lt 100000 ]");
+        run_line("i=$((i + 1))");
+    }
+    double lines = now() - t;
+    //Builds a 'for' loop over n words.
+    char *text = malloc(n * 8 + 64), *end = text + sprintf(text, "sum=0; for x in");
+    for(int i=0;i<n;i++)
+        end += sprintf(end, " %d", i);
+    sprintf(end, "; do sum=$((sum + x)); done");
+    t = now();
+    run_line(text);
+    double list = now() - t;
+    free(text);
+    printf("while loop (parse tree):      %10.0f iterations/s\n", n / loop);
+    printf("while loop (lines reparsed):  %10.0f iterations/s\n", n / lines);
+    printf("for loop over %d words:   %10.0f iterations/s\n", n, n / list);
+    printf("processes started:            %10ld\n", PROCESS_COUNT - processes);
+    printf("results correct:              %10s\n", counted && strtoll(return_var_value("sum"), NULL, 10) == (long long)n * (n - 1) / 2 ? "yes" : "no");
+}
+
+//Compares calling a shell function 100k times with sourcing a helper script holding its body for every call.
+void bench_functions(){
+    int n = 100000;
+    char path[] = "/tmp/eggshell_bench_XXXXXX", line[MAX_SIZE];
+    FILE *f = fdopen(mkstemp(path), "w");
+    fprintf(f, "total=$((total + ARG))\nif [ $((total %% 2)) -eq 0 ]; then even=$((even + 1)); fi\n");
+    fclose(f);
+    run_line("add() { local n=$1; total=$((total + n)); if [ $((total % 2)) -eq 0 ]; then even=$((even + 1)); fi; }");
+    run_line("total=0; even=0");
+    double t = now();
+    run_line("i=0; while [ $i -lt 100000 ]; do add $i; i=$((i + 1)); done");
+    double called = now() - t;
+    bool correct = strtoll(return_var_value("total"), NULL, 10) == (long long)n * (n - 1) / 2;
+    run_line("total=0; even=0");
+    sprintf(line, "i=0; while [ $i -lt 100000 ]; do ARG=$i; source %s; i=$((i + 1)); done", path);
+    t = now();
+    run_line(line);
+    double sourced = now() - t;
+    unlink(path);
+    printf("function call:             %10.0f calls/s\n", n / called);
+    printf("source of a helper script: %10.0f calls/s\n", n / sourced);
+    printf("results correct:           %10s\n", correct && strtoll(return_var_value("total"), NULL, 10) == (long long)n * (n - 1) / 2 ? "yes" : "no");
+}
+
+//Checks that conditions made of internal commands follow their own exit status rather than the one left before them, and times such a condition.
+void bench_conditions(){
+    struct {
+        char *line;
+        char *expected;
+    } cases[] = {
+        {"true; if chdir /nonexistent; then r=yes; else r=no; fi", "no"},
+        {"false; if chdir /; then r=yes; else r=no; fi", "yes"},
+        {"false; if print x; then r=yes; else r=no; fi", "yes"},
+        {"true; if print; then r=yes; else r=no; fi", "no"},
+        {"true; if unset NO_SUCH_VARIABLE; then r=yes; else r=no; fi", "no"},
+        {"false; if export BENCH_EXPORTED=1; then r=yes; else r=no; fi", "yes"},
+        {"true; if export 1x; then r=yes; else r=no; fi", "no"},
+        {"true; if hash no_such_command_here; then r=yes; else r=no; fi", "no"},
+        {"true; if source /nonexistent; then r=yes; else r=no; fi", "no"},
+        {"false; if source /dev/null; then r=yes; else r=no; fi", "yes"},
+        {"false; if jobs; then r=yes; else r=no; fi", "yes"},
+        {"true; if bg %99; then r=yes; else r=no; fi", "no"},
+        {"BENCH_COUNTED=1; r=0; while unset BENCH_COUNTED; do r=$((r + 1)); if [ $r -eq 5 ]; then break; fi; done", "1"},
+    };
+    int count = sizeof(cases) / sizeof(cases[0]), wrong = 0;
+    char cwd[PATH_MAX];
+    getcwd(cwd, sizeof(cwd));
+    //Hides the output and error messages of the internal commands.
+    fflush(stdout);
+    int saved_out = dup(STDOUT_FILENO), saved_err = dup(STDERR_FILENO), null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    for(int i=0;i<count;i++){
+        run_line(cases[i].line);
+        char *result = return_var_value("r");
+        if(result == NULL || strcmp(result, cases[i].expected) != 0)
+            wrong++;
+    }
+    fflush(stdout);
+    dup2(saved_out, STDOUT_FILENO);
+    dup2(saved_err, STDERR_FILENO);
+    close(saved_out), close(saved_err), close(null);
+    chdir(cwd);
+    double t = time_line("false; if print x; then r=yes; else r=no; fi", 100000);
+    printf("builtin condition:         %10.0f ns/line\n", t * 1e9);
+    printf("conditions correct:        %6d of %d\n", count - wrong, count);
+    if(wrong > 0){
+        fflush(stdout);
+        fprintf(stderr, "Error -- %d of %d conditions on internal commands took the wrong branch.\n", wrong, count);
+        failed = true;
+    }
+}
+
+/* ------------------- SUBSTITUTION ------------------- */
+
+//Compares command substitutions of an internal command (run in the shell) and of an external one (forked), and captures an 8MB output.
+void bench_substitution(){
+    int runs = 2000;
+    long processes = PROCESS_COUNT;
+    double internal = time_line("x=$(echo some words)", runs * 20);
+    long forked = PROCESS_COUNT - processes;
+    double external = time_line("x=$(/bin/echo some words)", runs);
+    //Writes a file of 8MB of lines and reads it back through a substitution.
+    char path[] = "/tmp/eggshell_bench_XXXXXX", line[MAX_SIZE], value[128];
+    memset(value, 'x', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+    FILE *f = fdopen(mkstemp(path), "w");
+    size_t size = 0;
+    while(size < 8 << 20)
+        size += fprintf(f, "%s\n", value);
+    fclose(f);
+    sprintf(line, "big=$(cat %s)", path);
+    double t = now();
+    run_line(line);
+    t = now() - t;
+    unlink(path);
+    printf("$(echo) internal:            %10.0f substitutions/s (%ld processes)\n", 1 / internal, forked);
+    printf("$(/bin/echo) forked:         %10.0f substitutions/s\n", 1 / external);
+    printf("8MB output captured:         %10.1f MB/s\n", size / t / 1e6);
+    printf("output intact:               %10s\n", strlen(return_var_value("big")) == size - 1 ? "yes" : "no");
+}
+
+/* ---------------------- HISTORY --------------------- */
+
+//Times opening a history of 1M entries (which maps it instead of reading it), and looking up and searching entries in it.
+void bench_history(){
+    char path[] = "/tmp/eggshell_bench_XXXXXX", name[64];
+    int entries = 1000000, runs = 100000;
+    char *commands[] = {"git commit -m", "ls -l /home/user", "make -j8 target", "print value", "cd /var/log/app"};
+    //Writes the log only, so the first open has to index it.
+    FILE *f = fdopen(mkstemp(path), "w");
+    for(int i=0;i<entries;i++){
+        fprintf(f, "%s %d", commands[i % 5], i);
+        fputc('\0', f);
+    }
+    fclose(f);
+    double t = now();
+    open_history(path);
+    double indexing = now() - t;
+    t = now();
+    close_history();
+    double sorting = now() - t;
+    //Reading every entry, as a history file of lines would be read when the shell starts.
+    t = now();
+    f = fopen(path, "r");
+    char *line = NULL;
+    size_t capacity = 0;
+    long count = 0;
+    while(getdelim(&line, &capacity, '\0', f) != -1)
+        count++;
+    fclose(f);
+    free(line);
+    double reading = now() - t;
+    t = now();
+    open_history(path);
+    double opening = now() - t;
+    //Looks up entries by number ('!n').
+    t = now();
+    size_t total = 0;
+    for(int i=0;i<runs;i++)
+        total += strlen(history_entry((i * 7919L) % entries));
+    double lookup = (now() - t) / runs;
+    //Searches a prefix matching one entry, and steps back through the 200k matches of another (the reverse search).
+    t = now();
+    for(int i=0;i<runs;i++){
+        sprintf(name, "git commit -m %d", (i * 5) % entries);
+        total += search_history(name, -1);
+    }
+    double rare = (now() - t) / runs;
+    t = now();
+    long n = -1;
+    for(int i=0;i<100;i++)
+        n = search_history("make", n);
+    double common = (now() - t) / 100;
+    //Adds unsorted entries, which are searched one by one.
+    for(int i=0;i<HISTORY_UNSORTED_LIMIT - 1;i++){
+        sprintf(name, "echo new %d", i);
+        add_history(name, strlen(name));
+    }
+    t = now();
+    for(int i=0;i<runs / 10;i++)
+        total += search_history("git commit -m 999995", -1);
+    double unsorted = (now() - t) / (runs / 10);
+    bool found = search_history("echo new 1022", -1) == entries + 1022 && strcmp(history_entry(entries - 5), "git commit -m 999995") == 0;
+    close_history();
+    unlink(path);
+    sprintf(name, "%s.index", path);
+    unlink(name);
+    sprintf(name, "%s.sorted", path);
+    unlink(name);
+    printf("first open (indexes 1M):     %10.1f ms\n", indexing * 1e3);
+    printf("sorting 1M at exit:          %10.1f ms\n", sorting * 1e3);
+    printf("reading every entry:         %10.1f ms (%ld entries)\n", reading * 1e3, count);
+    printf("open (mapped):               %10.1f us\n", opening * 1e6);
+    printf("!n lookup:                   %10.3f us\n", lookup * 1e6);
+    printf("!prefix (1 match):           %10.3f us\n", rare * 1e6);
+    printf("reverse step (200k matches): %10.3f us\n", common * 1e6);
+    printf("!prefix (1023 unsorted):     %10.3f us\n", unsorted * 1e6);
+    printf("entries found:               %10s\n", found ? "yes" : "no");
+}
+
+/* ------------------- LINE EDITOR -------------------- */
+
+//Times completing commands with 20k executables on PATH, and how soon the catalog sees an executable added to it.
+void bench_completion(){
+    char directory[] = "/tmp/eggshell_bench_XXXXXX", path[MAX_SIZE];
+    int entries = 20000, runs = 200;
+    mkdtemp(directory);
+    for(int i=0;i<entries;i++){
+        sprintf(path, "%s/tool%05d", directory, i);
+        close(open(path, O_WRONLY | O_CREAT, 0755));
+    }
+    modify_var("PATH", directory);
+    double t = now();
+    init_catalog();
+    while(true){
+        pthread_mutex_lock(&catalog.lock);
+        bool ready = catalog.ready && catalog.count == (size_t)entries;
+        pthread_mutex_unlock(&catalog.lock);
+        if(ready)
+            break;
+        usleep(100);
+    }
+    double indexing = now() - t;
+    //Completes a word matching every executable, one matching 10k, and one matching 10.
+    char *words[] = {"t", "tool1", "tool1234"};
+    double times[3];
+    int counts[3];
+    for(int w=0;w<3;w++){
+        size_t start;
+        t = now();
+        for(int i=0;i<runs;i++){
+            COMPLETIONS completions = {0};
+            counts[w] = find_completions(words[w], strlen(words[w]), &start, &completions);
+            free_completions(&completions);
+        }
+        times[w] = (now() - t) / runs;
+    }
+    //Adds an executable and waits for the thread to find it.
+    sprintf(path, "%s/newtool", directory);
+    t = now();
+    close(open(path, O_WRONLY | O_CREAT, 0755));
+    size_t start;
+    COMPLETIONS completions = {0};
+    while(find_completions("newt", 4, &start, &completions) == 0)
+        usleep(10);
+    double update = now() - t;
+    free_completions(&completions);
+    unlink(path);
+    for(int i=0;i<entries;i++){
+        sprintf(path, "%s/tool%05d", directory, i);
+        unlink(path);
+    }
+    rmdir(directory);
+    printf("indexing 20k executables:    %10.1f ms (in the background)\n", indexing * 1e3);
+    for(int w=0;w<3;w++){
+        sprintf(path, "complete '%s':", words[w]);
+        printf("%-29s%10.3f ms (%d matches)\n", path, times[w] * 1e3, counts[w]);
+    }
+    printf("new executable found after:  %10.3f ms\n", update * 1e3);
+}
+
+/* ---------------------- SERVER ---------------------- */
+
+//Sends a script to the server at 'path' like eggshell-client does, with 'out' as its stdout, and returns its exit code (-1 on error).
+int server_request(char *path, char *script, int out){
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    strcpy(address.sun_path, path);
+    int server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(connect(server, (struct sockaddr *)&address, sizeof(address)) == -1){
+        close(server);
+        return -1;
+    }
+    SERVER_REQUEST request = {strlen(script), 1};
+    int fds[] = {STDIN_FILENO, out, STDERR_FILENO};
+    int32_t code = -1;
+    if(send_fds(server, &request, sizeof(request), fds, 3) == -1 || write_all(server, script, request.script_length) == -1
+        || write_all(server, "/", 1) == -1 || read_all(server, (char *)&code, sizeof(code)) == -1)
+        code = -1;
+    close(server);
+    return code;
+}
+
+//Compares running scripts in the workers of 'eggshell --server' with starting a shell for each.
+void bench_server(){
+    char shell[MAX_SIZE], line[2 * MAX_SIZE], path[] = "/tmp/eggshell_bench_server.sock";
+    int runs = 1000;
+    ssize_t n = readlink("/proc/self/exe", shell, sizeof(shell) - 32);
+    shell[n > 0 ? n : 0] = '\0';
+    strcpy(strrchr(shell, '/') + 1, "Source_Code");
+    pid_t server = fork();
+    if(server == 0){
+        execl(shell, shell, "--server", path, NULL);
+        _exit(127);
+    }
+    //Waits for the socket.
+    int out = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    for(int i=0;i<1000 && server_request(path, "true", out) == -1;i++)
+        usleep(1000);
+    //Each request runs in a fresh copy of the server, so variables set by one are not seen by the next.
+    int captured = memfd_create("server", MFD_CLOEXEC);
+    server_request(path, "SERVER_BENCH=leaked; chdir /tmp", out);
+    int32_t code = server_request(path, "print [$SERVER_BENCH]; sh -c \"exit 3\"", captured);
+    char text[16] = "";
+    pread(captured, text, sizeof(text) - 1, 0);
+    close(captured);
+    double start = now();
+    for(int i=0;i<runs;i++)
+        server_request(path, "true", out);
+    double request = (now() - start) / runs;
+    sprintf(line, "%s", shell);
+    sprintf(strrchr(line, '/') + 1, "eggshell-client %s -c true", path);
+    double client = time_line(line, runs);
+    sprintf(line, "%s -c true", shell);
+    double command = time_line(line, runs);
+    kill(server, SIGTERM);
+    close(out);
+    unlink(path);
+    printf("isolated request:            %10s (exit code %d)\n", strcmp(text, "[]\n") == 0 ? "yes" : "no", code);
+    printf("server request:              %10.3f ms\n", request * 1e3);
+    printf("eggshell-client -c true:     %10.3f ms\n", client * 1e3);
+    printf("eggshell -c true:            %10.3f ms\n", command * 1e3);
+}
+
+/* ---------------------- ZYGOTE ---------------------- */
+
+//Compares the launch latency of fork, posix_spawn and the zygote, as the variable store grows.
+void bench_zygote(){
+    size_t stores[] = {0, 1024}; //MB of variable values.
+    int runs = 500;
+    char *launchers[] = {"fork", "spawn", "zygote"}, *program = find_command("true"), name[32];
+    char *value = malloc((1 << 20) + 1);
+    memset(value, 'x', 1 << 20);
+    value[1 << 20] = '\0';
+    printf("%-10s %14s %14s %14s\n", "store (MB)", "fork (us)", "spawn (us)", "zygote (us)");
+    for(int s=0;s<sizeof(stores)/sizeof(size_t);s++){
+        //Values of 1 MB each, copied (and so touched) by modify_var().
+        for(int i=0;i<stores[s];i++){
+            sprintf(name, "STORE_%d", i);
+            modify_var(name, value);
+        }
+        printf("%-10zu", stores[s]);
+        for(int l=0;l<3;l++){
+            modify_var("LAUNCHER", launchers[l]);
+            printf(" %14.1f", time_line(program, runs) * 1e6);
+        }
+        printf("\n");
+    }
+    delete_var("LAUNCHER");
+    clear_vars();
+    free(value);
+}
+
+/* --------------------- BUILTINS --------------------- */
+
+//Returns the index of an internal command by comparing the name with every builtin, as the parallel arrays were searched.
+int find_builtin_linear(char *name){
+    for(int i=0;i<BUILTIN_COUNT;i++){
+        if(strcmp(name, builtins[i].name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+//Compares looking up builtin and external names with a linear search and with the builtin hash, before and after registering 50 more builtins.
+void bench_builtins(){
+    char *names[] = {"print", "parallel", "exit", "ls", "grep", "printf"};
+    int count = sizeof(names) / sizeof(char *), runs = 1000000;
+    char name[32];
+    printf("%-10s %18s %18s\n", "builtins", "linear (ns/name)", "hash (ns/name)");
+    for(int pass=0;pass<2;pass++){
+        if(pass == 1){
+            for(int i=0;i<50;i++){
+                sprintf(name, "builtin%d", i);
+                register_builtin(strdup(name), &print_comm);
+            }
+        }
+        long found = 0;
+        double t = now();
+        for(int i=0;i<runs;i++)
+            found += find_builtin_linear(names[i % count]);
+        double linear = (now() - t) / runs * 1e9;
+        t = now();
+        for(int i=0;i<runs;i++)
+            found -= find_builtin(names[i % count]);
+        double hashed = (now() - t) / runs * 1e9;
+        if(found != 0)
+            fprintf(stderr, "Error -- the lookups disagree.\n");
+        printf("%-10d %18.1f %18.1f\n", BUILTIN_COUNT, linear, hashed);
+    }
+}
+
+/* ---------------------------------------------------- */
+
+//The available benchmarks.
+struct benchmark {
+    char *name;
+    void (*run)();
+} benchmarks[] = {
+    {"vars", &bench_vars},
+    {"expand", &bench_expand},
+    {"memory", &bench_memory},
+    {"source", &bench_source},
+    {"stream", &bench_stream},
+    {"repl", &bench_repl},
+    {"pipes", &bench_pipes},
+    {"spawn", &bench_spawn},
+    {"startup", &bench_startup},
+    {"export", &bench_export},
+    {"hash", &bench_hash},
+    {"redirect", &bench_redirect},
+    {"builtins", &bench_builtins},
+    {"fast", &bench_fast},
+    {"loops", &bench_loops},
+    {"functions", &bench_functions},
+    {"conditions", &bench_conditions},
+    {"substitution", &bench_substitution},
+    {"history", &bench_history},
+    {"completion", &bench_completion},
+    {"server", &bench_server},
+    {"zygote", &bench_zygote},
+};
+
+int main(int argc, char **argv){
+    //The zygote starts this program again (see start_zygote()).
+    if(argc > 2 && strcmp(argv[1], "--zygote") == 0)
+        return run_zygote(atoi(argv[2]));
+    init_builtins(); //Registers the internal commands.
+    init_jobs(); //Reaps the launched commands like the shell does.
+    for(int i=0;i<sizeof(benchmarks)/sizeof(benchmarks[0]);i++){
+        //Runs every benchmark, or only the ones named on the command line.
+        int selected = argc == 1;
+        for(int j=1;j<argc;j++)
+            selected |= strcmp(argv[j], benchmarks[i].name) == 0;
+        if(selected){
+            printf("--- %s ---\n", benchmarks[i].name);
+            define_var(); //Sets up the environment variables (the variable benchmarks clear them).
+            benchmarks[i].run();
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+//The client of 'eggshell --server' - runs a command ('-c command') or a script file in a worker of the server, with the client's stdin,
+//stdout, stderr and working directory, and exits with the exit code of the script.
+//Usage: eggshell-client socket (-c command | script)
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "protocol.h"
+
+int connect_server(char *path);
+int send_request(int server, char *script, size_t length, char *cwd);
+char *read_file(char *path, size_t *length);
+int write_all(int fd, char *buffer, size_t length);
+
+int main(int argc, char **argv){
+    bool command = argc > 2 && strcmp(argv[2], "-c") == 0;
+    if(argc < 3 || (command && argc < 4)){
+        fprintf(stderr,"Error -- Usage: %s socket (-c command | script)\n", argv[0]);
+        return 2;
+    }
+    size_t length;
+    char *script = command ? argv[3] : read_file(argv[2], &length);
+    if(script == NULL)
+        return 127;
+    if(command)
+        length = strlen(script);
+    char cwd[PATH_MAX];
+    if(getcwd(cwd, sizeof(cwd)) == NULL){
+        perror("Error -- getcwd()");
+        return 1;
+    }
+    int server = connect_server(argv[1]);
+    if(server == -1 || send_request(server, script, length, cwd) == -1){
+        perror("Error -- eggshell-client");
+        return 127;
+    }
+    //Waits for the exit code, while the worker writes to this process's stdout and stderr itself.
+    int32_t code;
+    size_t got = 0;
+    while(got < sizeof(code)){
+        ssize_t n = read(server, (char *)&code + got, sizeof(code) - got);
+        if(n == -1 && errno == EINTR)
+            continue;
+        if(n <= 0){
+            fprintf(stderr,"Error -- The server closed the connection before the script finished.\n");
+            return 127;
+        }
+        got += n;
+    }
+    return code;
+}
+
+//Connects to the server's socket, returning -1 on error.
+int connect_server(char *path){
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if(strlen(path) >= sizeof(address.sun_path)){
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    int server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(server == -1 || connect(server, (struct sockaddr *)&address, sizeof(address)) == -1)
+        return -1;
+    return server;
+}
+
+//Sends a request - its header with stdin, stdout and stderr attached, then the script and the working directory.
+int send_request(int server, char *script, size_t length, char *cwd){
+    SERVER_REQUEST request = {length, strlen(cwd)};
+    int fds[] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    union {
+        char buffer[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec part = {&request, sizeof(request)};
+    struct msghdr message = {.msg_iov = &part, .msg_iovlen = 1, .msg_control = control.buffer, .msg_controllen = sizeof(control.buffer)};
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+    ssize_t n;
+    while((n = sendmsg(server, &message, MSG_NOSIGNAL)) == -1 && errno == EINTR);
+    if(n == -1 || ((size_t)n < sizeof(request) && write_all(server, (char *)&request + n, sizeof(request) - n) == -1))
+        return -1;
+    return write_all(server, script, length) == -1 || write_all(server, cwd, request.cwd_length) == -1 ? -1 : 0;
+}
+
+//Reads a whole file into a new string, returning NULL (after displaying the error) if it cannot be read.
+char *read_file(char *path, size_t *length){
+    FILE *file = fopen(path, "r");
+    if(file == NULL){
+        perror("Error -- fopen()");
+        return NULL;
+    }
+    char *text = NULL;
+    size_t capacity = 0;
+    *length = 0;
+    size_t n;
+    do {
+        if(*length + 4096 > capacity){
+            capacity = 2 * (*length + 4096);
+            text = realloc(text, capacity);
+        }
+        n = fread(text + *length, 1, capacity - *length, file);
+        *length += n;
+    } while(n > 0);
+    fclose(file);
+    return text;
+}
+
+//Writes the whole buffer, returning -1 on error.
+int write_all(int fd, char *buffer, size_t length){
+    while(length > 0){
+        ssize_t n = write(fd, buffer, length);
+        if(n == -1 && errno == EINTR)
+            continue;
+        if(n == -1)
+            return -1;
+        buffer += n;
+        length -= n;
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 #ifndef OS_THING_HEADER_H
 #define OS_THING_HEADER_H
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,37 +9,458 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <memory.h>
-#define _GNU_SOURCE
 #include <unistd.h>
 #include <stdbool.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/file.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <termios.h>
+#include <poll.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include "protocol.h"
 
 #define DELIMITERS " \t\r\n"
 #define MAX_SIZE 1024
+#define ARENA_BLOCK_SIZE 4096
+#define ARENA_KEEP_LIMIT (1 << 20) //Largest block kept when an arena is reset.
+#define SCRIPT_CACHE_LIMIT (1 << 20) //Larger scripts are executed while they are read, without caching them.
+#define SCRIPT_BUFFER_SIZE (1 << 20) //The read buffer for those scripts.
+#define HISTORY_FILE ".eggshell_history" //The history file in the home directory, when 'HISTFILE' is not set.
+#define ZYGOTE_TEXT_LIMIT (128 * 1024) //Most bytes of path, arguments and environment sent to the zygote for one program.
+#define LITERAL_MARK '\001' //Put before a character of a word that expand_word() keeps as it is - a '$' or '`' from single quotes, or a name character next to a quote.
+#define REDIRECT_FAILED -2 //Returned instead of a PID when a command was not launched because a redirection failed.
+#define PASSED_FD_LIMIT 16 //Most descriptors sent in one message over a Unix socket.
+#define COMPLETION_LIST_LIMIT 100 //The editor asks before displaying more completions than this.
+#define CATALOG_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB) //Changes of the PATH directories that update the catalog.
+#define HISTORY_UNSORTED_LIMIT 1024 //Newest history entries searched one by one before the shell sorts them into the index.
+
+/* ----------- TYPE DEFINITIONS --------- */
+
+/* Definitions for Tokens */
+//The kinds of tokens produced by the lexer.
+typedef enum token_type {
+    WORD,
+    PIPE, // |
+    OUT_REDIRECT, // >
+    APPEND_REDIRECT, // >>
+    IN_REDIRECT, // <
+    HERE_STRING, // <<<
+    HERE_DOCUMENT, // <<
+    BACKGROUND, // &
+    SEMICOLON, // ;
+    NEWLINE,
+    KEYWORD //A reserved word where a command would start, e.g. 'if' or 'done' (and the 'in' of a 'for' loop, or the '()' after a function name).
+} TOKEN_TYPE;
+
+typedef struct token {
+    char *text; //The word without its quotes, or the operator.
+    TOKEN_TYPE type;
+    bool quoted; //Whether any part of the word was in quotes.
+    bool expand; //Whether the word has variables to expand (outside single quotes), or is the body of a 'HERE document' with variables and an unquoted delimiter.
+} TOKEN;
+
+//A tokenized line or script.
+typedef struct tokens {
+    TOKEN *tokens;
+    int size;
+    int capacity;
+    int *operators; //The positions of the operator tokens, in order.
+    int op_count;
+    char *text; //Space for the text of the words.
+    size_t text_capacity;
+    bool incomplete; //Whether the input ended before the body of a 'HERE document', an 'if', a loop or a '{' did, or after a '\' continuing the line.
+    char *open_delimiter; //The delimiter of the 'HERE document' that did not end (NULL if none).
+} TOKENS;
+
+//Reads the statements of the terminal or a script (a line, with the lines it continues on), reusing its buffers.
+typedef struct reader {
+    FILE *input;
+    char *line; //The last line read.
+    size_t line_capacity;
+    char *text; //The lines of the statement.
+    size_t length;
+    size_t capacity;
+    TOKENS tokens; //The tokens of the statement.
+    bool history; //Whether history references ('!!', '!n'...) in the lines are replaced (only for the terminal).
+    bool edit; //Whether the lines are read with the line editor (only for the terminal).
+} READER;
+
+/* Definitions for Arenas */
+//A block of an arena.
+typedef struct arena_block {
+    struct arena_block *next; //The previous (smaller) block.
+    size_t size;
+    size_t used;
+    char data[];
+} ARENA_BLOCK;
+
+//A bump allocator whose memory is freed all at once.
+typedef struct arena {
+    ARENA_BLOCK *blocks; //The newest block first.
+    size_t used; //Bytes handed out by the arena.
+    size_t garbage; //Bytes handed out that are no longer used.
+} ARENA;
+
+/* Definitions for the Parse Tree */
+//A buffer for the expanded words of a command or redirection, growing in the arena of its script.
+typedef struct expansion {
+    ARENA *arena;
+    char *text;
+    size_t capacity;
+} EXPANSION;
+
+typedef enum command_type {
+    ASSIGNMENT,
+    BUILTIN,
+    EXTERNAL
+} COMMAND_TYPE;
+
+//A redirection of a command, e.g. '> file' or '<<< some text'.
+typedef struct redirect {
+    TOKEN_TYPE type;
+    TOKEN *words; //The file name, the body of a 'HERE document', or every word of a 'HERE string'.
+    int word_count;
+    char **args; //Space for the expanded words.
+    EXPANSION expansion;
+} REDIRECT;
+
+//A command - one stage of a pipeline.
+typedef struct command {
+    COMMAND_TYPE type;
+    int builtin; //Index into 'builtins' if the name is known when parsing, otherwise -1.
+    TOKEN *words;
+    int word_count;
+    char **args; //Space for the expanded words.
+    EXPANSION expansion;
+    REDIRECT *redirects;
+    int redirect_count;
+} COMMAND;
+
+typedef struct pipeline {
+    COMMAND *commands;
+    int count;
+    bool background; //Whether the pipeline ended with '&'.
+} PIPELINE;
+
+typedef enum statement_type {
+    PIPELINE_STATEMENT,
+    IF_STATEMENT,
+    WHILE_STATEMENT,
+    UNTIL_STATEMENT,
+    FOR_STATEMENT,
+    GROUP_STATEMENT, // { list; }
+    FUNCTION_STATEMENT // name() { list; }
+} STATEMENT_TYPE;
+
+//A pipeline, or a compound command running lists of statements.
+typedef struct statement {
+    STATEMENT_TYPE type;
+    PIPELINE pipeline;
+    struct statement *condition; //The condition of an 'if', 'while' or 'until'.
+    struct statement *body; //The 'then' part of an 'if', or the body of a loop, group or function.
+    struct statement *otherwise; //The 'else' part of an 'if' (an 'elif' is an 'if' on its own here).
+    char *variable; //The variable of a 'for' loop, or the name of a function.
+    TOKEN *words; //The words a 'for' loop goes through.
+    int word_count;
+    char **args; //Space for the expanded words.
+    EXPANSION expansion;
+    struct statement *next; //The next statement of the list.
+} STATEMENT;
+
+//A parsed line or script - every node is allocated in its arena.
+typedef struct script {
+    ARENA arena;
+    STATEMENT *statements; //The first statement.
+    int count;
+    //The key of a script cached by 'source'.
+    char *path;
+    struct timespec mtime;
+    off_t size;
+    int users; //Number of 'source' commands (or calls of a function) running the script.
+    bool stale; //Set once the file changed, so the script is freed when its last user finishes.
+    struct script *next;
+} SCRIPT;
+
+//The position of the parser in a token list.
+typedef struct parser {
+    TOKENS *tokens;
+    int position; //The next token.
+    int op; //The first operator at or after 'position'.
+    SCRIPT *script;
+} PARSER;
+
+/* Definitions for Functions */
+//A variable declared with 'local', which hides the variable with the same name until its function returns.
+typedef struct local {
+    char *name;
+    char *value;
+    size_t capacity; //Bytes allocated for the value.
+} LOCAL;
+
+//The positional parameters and local variables of a running shell function.
+typedef struct frame {
+    char **args; //The name of the function and the arguments it was called with ('$1'...), copied for the call.
+    int count; //Number of arguments ('$#').
+    char count_text[16];
+    char *all; //The arguments joined with spaces ('$@' and '$*').
+    LOCAL *locals;
+    int local_count;
+    int local_capacity;
+    struct frame *previous; //The frame of the caller.
+} FRAME;
+
+/* Definitions for History */
+//The statements typed into the terminal, in a log shared by every shell that is never parsed whole.
+//The log ('HISTFILE') holds the entries ended by '\0', only ever appended to; 'HISTFILE.index' holds the offset of each entry in the log,
+//and 'HISTFILE.sorted' the numbers of the entries in the order of their text, for prefix searches. All three are mapped into memory.
+typedef struct history {
+    char *path; //NULL while the history is not open.
+    int log_fd;
+    int index_fd;
+    char *log; //The mapped log.
+    size_t log_size;
+    uint64_t *offsets; //The mapped index - where each entry starts in the log.
+    size_t count; //Number of entries.
+    uint32_t *sorted; //The mapped sorted index, of the first 'sorted_count' entries (the newer ones are searched one by one).
+    size_t sorted_count;
+} HISTORY;
+
+/* Definitions for the Line Editor */
+//The keys the editor reads as escape sequences (the others are their characters).
+typedef enum editor_key {
+    KEY_LEFT = 1000,
+    KEY_RIGHT,
+    KEY_UP,
+    KEY_DOWN,
+    KEY_HOME,
+    KEY_END,
+    KEY_DELETE
+} EDITOR_KEY;
+
+//A line being edited in the terminal.
+typedef struct editor {
+    char *line;
+    size_t length;
+    size_t capacity;
+    size_t cursor;
+    size_t drawn; //Where the cursor was drawn, from the start of the line.
+    bool first; //Whether the line starts a statement (so the prompt is drawn before it).
+    long position; //The history entry shown, or 'history.count' for the line being typed.
+    char *typed; //The line being typed, kept while history entries are shown.
+} EDITOR;
+
+//The words that complete the one before the cursor.
+typedef struct completions {
+    char **matches;
+    int count;
+    int capacity;
+} COMPLETIONS;
+
+//An executable in a directory of PATH.
+typedef struct executable {
+    char *name;
+    int directory; //Index into 'catalog.directories'.
+} EXECUTABLE;
+
+//The executables on PATH, sorted by name. A thread builds the catalog and keeps it up to date by watching the directories,
+//so completing a command never reads them.
+typedef struct catalog {
+    pthread_mutex_t lock; //Held while 'entries' or 'path' change, or while they are read.
+    EXECUTABLE *entries;
+    size_t count;
+    size_t capacity;
+    bool ready; //Set once the first PATH was indexed.
+    char *path; //A PATH waiting to be indexed (NULL if none).
+    int wake[2]; //A pipe waking the thread when there is a new PATH.
+    bool started;
+    //Used by the thread only.
+    char **directories;
+    int *watches; //The inotify watch of each directory.
+    int directory_count;
+} CATALOG;
+
+/* Definitions for the Zygote */
+//A launch sent to the zygote, with the stdin, stdout and stderr of the program attached.
+//The path of the program, its arguments and its environment follow in a second message, each ended by '\0'.
+typedef struct zygote_request {
+    pid_t pgid; //The process group the program joins (0 for a new one), or -1 to stay in the shell's group.
+    uint32_t length; //Bytes of the second message.
+    int32_t arg_count;
+    int32_t env_count;
+} ZYGOTE_REQUEST;
+
+//A message from the zygote - the PID of a program it launched (-1 if it failed, with the error in 'status'), or a change in the state of one.
+typedef struct zygote_message {
+    bool launched; //Whether the message answers a launch (otherwise 'status' is a wait status).
+    pid_t pid;
+    int status;
+} ZYGOTE_MESSAGE;
+
+//A small process launching external programs for the shell (LAUNCHER=zygote), so launching does not depend on the size of the shell.
+typedef struct zygote {
+    pid_t pid; //0 while no zygote was started, -1 if it could not be.
+    int socket;
+    pid_t owner; //The shell process the zygote launches for (a forked child of the shell starts its own).
+    char *text; //The second message of a launch, reused.
+    size_t capacity;
+} ZYGOTE;
+
+/* Definitions for Jobs */
+//A pipeline (or command) started by the shell.
+typedef struct job {
+    bool used; //Entries of the job table are reused once their job is freed.
+    int id; //The number shown by 'jobs'.
+    pid_t pgid; //The process group of the job (0 before its first process starts).
+    pid_t *pids; //The process of each stage (-1 if it could not be started).
+    int *statuses; //The wait status of each stage (-1 while it runs).
+    int count;
+    int capacity;
+    int running; //Number of processes still running (or stopped).
+    bool stopped;
+    int stop_status;
+    bool background;
+    PIPELINE *pipeline; //The pipeline the job came from, until its text is built.
+    char **args; //Or the arguments of a launched command.
+    char *text; //The command line displayed by 'jobs' (built only when it is needed).
+} JOB;
+
+//A child reaped by the SIGCHLD handler.
+typedef struct reaped_child {
+    pid_t pid;
+    int status;
+} REAPED_CHILD;
+
+/* Definitions for Internal Commands */
+//An internal command and the function that runs it.
+typedef struct builtin {
+    char *name;
+    int (*function)(char **args);
+    SCRIPT *script; //The body of a shell function (NULL for the other internal commands).
+} BUILTIN_COMMAND;
 
 /* --------- FUNCTION DEFINITIONS ------- */
 
 /* Core Functions */
+int run_batch(char **argv);
+int run_string(char *text);
+int last_status();
+int exit_status();
 void start();
-char *read_line();
-char **split_line(char *line);
-int execute (char **args);
-int execute_redirect(char **left, char **right, int choice);
-int execute_pipe(char **left, char **right);
-
-/* Other Functions */
-int is_redirect(char **args, char **red1, char **red2);
-int is_pipe(char **args, char **pipe1, char **pipe2);
-int split_args(char **args, char **first, char **second, char *c);
-int get_size_args(char **args);
+bool read_statement(READER *reader);
+void free_reader(READER *reader);
+int lex_line(char *line, TOKENS *tokens);
+int parse_tokens(TOKENS *tokens, SCRIPT *script);
+int execute_script(SCRIPT *script);
+int execute_list(STATEMENT *statement);
+int execute_statement(STATEMENT *statement);
+int execute_loop(STATEMENT *statement);
+int execute_for(STATEMENT *statement);
+bool succeeded();
+bool jumping();
+bool leave_loop();
+int execute (PIPELINE *pipeline);
+int execute_command(COMMAND *command);
+int execute_pipe(PIPELINE *pipeline);
+int apply_redirects(COMMAND *command);
+int open_redirects(COMMAND *command, int *fds, int *opened);
+int here_input(REDIRECT *redirect, char **words);
+int here_document(char *text, size_t length);
+int write_all(int fd, char *buffer, size_t length);
+int read_all(int fd, char *buffer, size_t length);
+void exec_command(COMMAND *command);
+int redirect_in_process(COMMAND *command);
+
+/* Functions for Tokens */
+void reserve_tokens(TOKENS *tokens, size_t length);
+TOKEN *add_token(TOKENS *tokens, TOKEN_TYPE type, char *text);
+char *lex_here_document(char *p, TOKEN *delimiter, char **text, TOKENS *tokens);
+void free_tokens(TOKENS *tokens);
+char **build_args(TOKEN *words, int count, char **args, EXPANSION *expansion);
+size_t expand_word(char *word, EXPANSION *expansion, size_t length);
+void reserve_expansion(EXPANSION *expansion, size_t size);
+bool is_reserved(char *word);
+bool is_reserved_start(char *word);
+bool is_reserved_end(char *word);
+bool is_substitution(char *p);
+char *substitution_end(char *p);
+char *lex_substitution(char *p, char **text, TOKENS *tokens);
+size_t command_substitution(char *text, EXPANSION *expansion, size_t length);
+bool substitute_in_process(STATEMENT *statement);
+size_t read_output(int fd, EXPANSION *expansion, size_t length);
+long long evaluate_arithmetic(char **p, int precedence, bool *error);
+long long arithmetic_operand(char **p, bool *error);
+int arithmetic_operator(char *p, int *length);
+long long apply_arithmetic(char *op, int length, long long a, long long b, bool *error);
+
+/* Functions for the Parse Tree */
+int find_builtin(char *name);
+int builtin_slot(char *name, unsigned int seed);
+void init_builtins();
+int register_builtin(char *name, int (*function)(char **));
+void hash_builtins();
+void copy_word(SCRIPT *script, TOKEN *to, TOKEN *from);
+int parse_command(TOKENS *tokens, int start, int end, int redirect_count, SCRIPT *script, COMMAND *command);
+STATEMENT *copy_statements(SCRIPT *script, STATEMENT *from);
+TOKEN *copy_words(SCRIPT *script, TOKEN *from, int count, char ***args, EXPANSION *expansion);
+STATEMENT *parse_list(PARSER *parser, bool *valid);
+STATEMENT *parse_statement(PARSER *parser);
+int parse_pipeline(PARSER *parser, PIPELINE *pipeline);
+STATEMENT *parse_if(PARSER *parser);
+STATEMENT *parse_loop(PARSER *parser);
+STATEMENT *parse_for(PARSER *parser);
+STATEMENT *parse_group(PARSER *parser);
+STATEMENT *parse_function(PARSER *parser);
+STATEMENT *new_statement(PARSER *parser, STATEMENT_TYPE type);
+bool expect_condition(PARSER *parser, STATEMENT *statement);
+bool expect_keyword(PARSER *parser, char *keyword);
+bool is_keyword(PARSER *parser, char *keyword);
+int next_operator(PARSER *parser);
+void skip_statement(PARSER *parser);
+SCRIPT *load_script(char *path, struct stat *info);
+int stream_script(char *path);
+void free_script(SCRIPT *script);
+
+/* Functions for Arenas */
+char *arena_alloc(ARENA *arena, size_t size);
+void *arena_new(ARENA *arena, size_t size);
+char *arena_strdup(ARENA *arena, char *string);
+void reset_arena(ARENA *arena);
+void free_arena(ARENA *arena);
 
 /* Functions for Variables */
+unsigned int hash_name(char *name);
+unsigned int hash_name_length(char *name, size_t length);
+int find_var(char *name);
+int find_var_length(char *name, size_t length);
+void resize_var_index(int size);
 int modify_var(char *name, char *value);
+int delete_var(char *name);
+void compact_arena();
+int assignment_name_length(char *arg);
+int name_length_of(char *text);
 int is_var_assignment(char *arg);
+void assign_var(char *name, char *value);
+char *lookup_var(char *name, size_t length);
+LOCAL *find_local(char *name, size_t length);
+void set_local(LOCAL *local, char *value);
 char *return_var_value(char *name);
-char *return_env_var(char *name);
-char *set_var_value(char *arg);
+int export_var(char *name);
+void update_env(int i);
+void unexport_var(int i);
 //Setting Environment Variables
 void define_var();
 void set_terminal();
@@ -52,28 +474,248 @@ int print_comm(char **args);
 int chdir_comm(char **args);
 int all_comm(char **args);
 int source_comm(char **args);
+int unset_comm(char **args);
+int hash_comm(char **args);
+int jobs_comm(char **args);
+int fg_comm(char **args);
+int bg_comm(char **args);
+int wait_comm(char **args);
+int parallel_comm(char **args);
+int break_comm(char **args);
+int continue_comm(char **args);
+int local_comm(char **args);
+int return_comm(char **args);
+int export_comm(char **args);
+//Shell Functions.
+void define_function(STATEMENT *statement);
+int function_comm(char **args);
+void push_frame(FRAME *frame, char **args);
+void pop_frame(FRAME *frame);
+char **copy_args(char **args);
+//Internal versions of common utilities.
+int true_comm(char **args);
+int false_comm(char **args);
+int echo_comm(char **args);
+int printf_comm(char **args);
+int cat_comm(char **args);
+int test_comm(char **args);
+char *print_escape(char *p, bool echo, bool *stop);
+long long printf_number(char *value, int *status);
+int copy_fd(int from, int to);
+int evaluate_test(char **args, int count);
 //External Commands.
 int launch (char **args);
+JOB *parallel_job(char **template, int count, char *item, int in, int out, int err);
+void copy_output(int from, int to);
+void exec_external(char **args);
+bool is_external(COMMAND *command);
+bool use_spawn();
+pid_t spawn_command(COMMAND *command, char **args, int in, int out, pid_t pgid);
+//Command Hash Functions.
+char *find_command(char *name);
+char *search_path(char *name);
+void clear_command_hash();
+
+/* Functions for History */
+void init_history();
+int open_history(char *path);
+bool map_history();
+void map_sorted();
+void *map_file(int fd, size_t size);
+void add_history(char *text, size_t length);
+char *history_entry(size_t n);
+long search_history(char *prefix, long before);
+size_t sorted_bound(char *prefix, size_t length, bool after);
+int compare_history(const void *a, const void *b);
+char *expand_history(char *line, bool *error);
+void sort_history();
+void close_history();
+int history_comm(char **args);
+
+/* Functions for the Line Editor */
+ssize_t edit_line(READER *reader);
+int read_key();
+int read_byte(int timeout);
+void draw_line(EDITOR *editor, char *text, size_t length, size_t cursor);
+void redraw_line(EDITOR *editor);
+void insert_text(EDITOR *editor, char *text, size_t length);
+void delete_text(EDITOR *editor, size_t start, size_t end);
+void set_line(EDITOR *editor, char *text);
+void show_history(EDITOR *editor, long position);
+int reverse_search(EDITOR *editor);
+void complete(EDITOR *editor, bool list);
+void list_completions(EDITOR *editor, COMPLETIONS *completions);
+int find_completions(char *line, size_t cursor, size_t *start, COMPLETIONS *completions);
+bool command_position(char *line, size_t start);
+void add_completion(COMPLETIONS *completions, char *prefix, char *name, char *suffix);
+void free_completions(COMPLETIONS *completions);
+int compare_names(const void *a, const void *b);
+//Catalog Functions
+void init_catalog();
+void refresh_catalog(char *path);
+void *catalog_thread(void *unused);
+void index_path(char *path, int inotify);
+void update_catalog(struct inotify_event *event);
+bool is_executable_in(char *directory, char *name);
+size_t catalog_position(char *name, int directory);
+int compare_executables(const void *a, const void *b);
+
+/* Functions for the Server */
+int run_server(char *path, int workers);
+pid_t start_worker(int listener, pid_t server);
+int serve_request(int listener);
+int send_fds(int socket, void *data, size_t size, int *fds, int count);
+int receive_fds(int socket, void *data, size_t size, int *fds, int count);
+
+/* Functions for the Zygote */
+int run_zygote(int fd);
+pid_t zygote_fork(ZYGOTE_REQUEST *request, char *text, int *fds, sigset_t *children);
+bool use_zygote();
+void start_zygote();
+pid_t zygote_command(COMMAND *command, char **args, int in, int out, pid_t pgid);
+pid_t zygote_launch(char *path, char **args, int *fds, pid_t pgid);
+bool read_zygote(ZYGOTE_MESSAGE *message, bool wait);
+void lose_zygote();
 
 /* Functions for Process Management */
 //Signalling Functions
 void signals (int signal);
+//Forking Functions
+pid_t fork_process(pid_t pgid);
+//Job Functions
+void init_jobs();
+void sigchld_handler(int signal);
+void reap_children();
+void update_job(pid_t pid, int status);
+JOB *new_job(PIPELINE *pipeline, char **args, int count);
+void add_job_process(JOB *job, pid_t pid);
+pid_t job_pgid(JOB *job);
+void run_job(JOB *job, bool background);
+int wait_job(JOB *job, bool foreground);
+int job_status(JOB *job);
+void continue_job(JOB *job);
+void notify_jobs();
+char *job_state(JOB *job);
+char *job_text(JOB *job);
+JOB *find_job(char *spec);
+JOB *find_pid_job(pid_t pid);
+void free_job(JOB *job);
+void forget_jobs();
 
 /* ---------- GLOBAL VARIABLES ---------- */
 
 /* Definitions for Variables */
 typedef struct variable {
-    char name[MAX_SIZE];
-    char value[MAX_SIZE];
+    char *name; //Interned name - the table owns the only copy (NULL if the variable was deleted).
+    char *value; //Stored in the arena right after the name.
+    int value_size; //Bytes of arena space available for the value.
+    unsigned int hash; //Cached hash of the name.
+    int env_slot; //Position of the variable's 'NAME=VALUE' string in 'envp' (-1 if it is not exported).
 } VARIABLE;
+ARENA var_arena; //Holds the variable names and values (its garbage is old values and deleted variables).
 
+//Variables are kept in insertion order in 'variables' and found through 'var_index'.
 VARIABLE *variables;
-int VAR_SIZE = 0; //Number of environment variables.
+int VAR_SIZE = 0; //Number of used entries in 'variables' (including deleted ones).
+int VAR_CAPACITY = 0; //Number of allocated entries in 'variables'.
+int VAR_COUNT = 0; //Number of environment variables.
+//Open-addressing hash table of indices into 'variables' (-1 marks an empty slot).
+int *var_index;
+int VAR_INDEX_SIZE = 0; //Number of slots in 'var_index' (always a power of two).
+//The 'NAME=VALUE' strings of the exported variables (NULL-terminated), passed to the programs the shell launches.
+//A string is rebuilt only when its variable changes, so launching a program does not build an environment.
+char **envp;
+int ENV_COUNT = 0;
+int ENV_CAPACITY = 0;
+
+/* Definitions for Processes */
+long PROCESS_COUNT = 0; //Number of processes the shell forked or spawned.
+
+/* Definitions for the Command Hash */
+//An external command and the full path it was found at.
+typedef struct hashed_command {
+    char *name; //NULL for an empty slot.
+    char *path;
+    int hits; //Number of times the command was looked up.
+    unsigned int hash;
+} HASHED_COMMAND;
+
+HASHED_COMMAND *command_hash; //Open-addressing hash table of the commands found in PATH.
+int HASH_SIZE = 0; //Number of slots in 'command_hash' (always a power of two).
+int HASH_COUNT = 0; //Number of hashed commands.
+
+/* Definitions for Jobs */
+JOB **job_table; //The jobs started by the shell, indexed by their id - 1.
+int JOB_SIZE = 0; //Number of entries in 'job_table'.
+bool INTERACTIVE = false; //Whether the shell reads statements typed into a terminal (not a '-c' command, a script file or a pipe).
+bool JOB_CONTROL = false; //Whether jobs get process groups and the terminal (only in an interactive shell).
+pid_t SHELL_PGID = 0;
+//The signals ignored by an interactive shell and restored in its children.
+int JOB_SIGNALS[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU};
+//Children reaped by the SIGCHLD handler, waiting to be recorded in the job table.
+#define REAP_SIZE 64
+REAPED_CHILD reaped[REAP_SIZE];
+volatile sig_atomic_t REAPED_COUNT = 0;
+
+/* Definitions for Scripts */
+SCRIPT *script_cache; //Scripts parsed by 'source', newest first.
+//The reserved words of compound commands.
+char *KEYWORDS[] = {"if", "then", "elif", "else", "fi", "while", "until", "for", "do", "done", "{", "}", NULL};
+int LOOP_DEPTH = 0; //Number of loops running.
+int LOOP_EXITS = 0; //Number of loops a 'break' or 'continue' is leaving (the statements in them are skipped).
+bool LOOP_CONTINUE = false; //Whether the last loop left continues with its next iteration.
+bool RETURNING = false; //Whether a 'return' is leaving the running function (the statements in it are skipped).
+
+/* Definitions for Functions */
+FRAME *FRAMES; //The frame of the running function (NULL outside functions), linked to the frames of its callers.
+
+/* Definitions for History */
+HISTORY history = {.log_fd = -1, .index_fd = -1};
+
+/* Definitions for the Line Editor */
+CATALOG catalog = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = {-1, -1}};
+
+/* Definitions for the Zygote */
+ZYGOTE zygote = {.socket = -1};
 
 /* Definitions for Commands */
-//An array of pointers to command functions.
-int (*commands[]) (char **) = {&exit_comm,&print_comm,&chdir_comm,&all_comm,&source_comm};
-//An array of commands names.
-char *commands_names[] = {"exit","print","chdir","all","source"};
+//The internal commands the shell starts with - new ones are added here, or at run time with register_builtin().
+BUILTIN_COMMAND default_builtins[] = {
+    {"exit", &exit_comm},
+    {"print", &print_comm},
+    {"chdir", &chdir_comm},
+    {"all", &all_comm},
+    {"source", &source_comm},
+    {"unset", &unset_comm},
+    {"hash", &hash_comm},
+    {"jobs", &jobs_comm},
+    {"fg", &fg_comm},
+    {"bg", &bg_comm},
+    {"wait", &wait_comm},
+    {"parallel", &parallel_comm},
+    {"break", &break_comm},
+    {"continue", &continue_comm},
+    {"local", &local_comm},
+    {"return", &return_comm},
+    {"history", &history_comm},
+    {"export", &export_comm},
+    {"true", &true_comm},
+    {"false", &false_comm},
+    {"echo", &echo_comm},
+    {"printf", &printf_comm},
+    {"cat", &cat_comm},
+    {"test", &test_comm},
+    {"[", &test_comm},
+};
+
+//The internal commands that only write output, which a command substitution runs without forking.
+int (*OUTPUT_BUILTINS[])(char **) = {&print_comm, &echo_comm, &printf_comm, &cat_comm, &test_comm, &true_comm, &false_comm, &all_comm, NULL};
+
+BUILTIN_COMMAND *builtins; //The registered internal commands, in the order they were registered.
+int BUILTIN_COUNT = 0;
+//Hash table of indices into 'builtins' (-1 marks an empty slot) with no collisions for the seed.
+int *builtin_hash;
+int BUILTIN_HASH_SIZE = 0; //Number of slots in 'builtin_hash' (always a power of two).
+unsigned int BUILTIN_SEED = 0;
 
 #endif //OS_THING_HEADER_H
\ No newline at end of file
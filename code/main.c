@@ -1,523 +1,4896 @@
 //Includes all functions, libraries and global variables.
 #include "header.h"
 
-int main() {
+//The benchmarks include this file and provide their own main().
+#ifndef EGGSHELL_NO_MAIN
+int main(int argc, char **argv) {
+    //'eggshell -c command' and 'eggshell script' run without reading statements, like a pipe into the shell does.
+    bool batch = argc > 1;
+    if(batch && (strcmp(argv[1], "-c") == 0 || strcmp(argv[1], "--server") == 0) && argc == 2){
+        fprintf(stderr,"Error -- No %s inputted after \'%s\'.\n", argv[1][1] == 'c' ? "command" : "socket", argv[1]);
+        return 2;
+    }
+    //'eggshell --zygote fd' is the zygote the shell starts for itself (see start_zygote()).
+    if(batch && strcmp(argv[1], "--zygote") == 0 && argc > 2)
+        return run_zygote(atoi(argv[2]));
+    //'eggshell --server socket [workers]' runs the scripts clients send to a socket in workers set up in advance.
+    if(batch && strcmp(argv[1], "--server") == 0){
+        define_var();
+        init_builtins();
+        return run_server(argv[2], argc > 3 ? atoi(argv[3]) : SERVER_WORKERS);
+    }
+    INTERACTIVE = !batch && isatty(STDIN_FILENO);
     define_var(); //Sets up the environment variables.
+    init_builtins(); //Sets up the internal commands.
+    init_jobs(); //Sets up job control.
+    if(batch)
+        return run_batch(argv);
+    init_history(); //Opens the history of the terminal.
+    //Starts indexing the commands on PATH for tab completion.
+    if(INTERACTIVE)
+        init_catalog();
     start(); //Starts the terminal.
+    close_history(); //Sorts the new history entries.
+    return exit_status();
+}
+#endif
+
+//Runs 'eggshell -c command [name args...]' or 'eggshell script [args...]', with the arguments after the command (or the script) as its positional parameters.
+//Returns the exit code of the shell.
+int run_batch(char **argv){
+    bool command = strcmp(argv[1], "-c") == 0;
+    char **args = command ? argv + 3 : argv + 1;
+    if(!command && access(argv[1], R_OK) == -1){
+        perror("Error -- access()");
+        return 127;
+    }
+    FRAME frame = {0};
+    if(args[0] != NULL)
+        push_frame(&frame, args);
+    if(command){
+        run_string(argv[2]);
+    } else {
+        char *source[] = {"source", argv[1], NULL};
+        source_comm(source);
+    }
+    if(args[0] != NULL)
+        pop_frame(&frame);
+    return exit_status();
+}
+
+//Tokenizes, parses and executes a string of statements, returning 0 if one of them was the 'exit' command.
+int run_string(char *text){
+    TOKENS tokens = {0};
+    SCRIPT script = {0};
+    lex_line(text, &tokens);
+    parse_tokens(&tokens, &script);
+    int status = execute_script(&script);
+    free_tokens(&tokens);
+    free_arena(&script.arena);
+    return status;
+}
+
+//Returns the wait status of the last command (EXITCODE), or 0 if it is not set.
+int last_status(){
+    char *value = return_var_value("EXITCODE");
+    return value == NULL ? 0 : atoi(value);
+}
+
+//Returns the exit code of the shell for the wait status of the last command (128 + the signal if it was killed).
+int exit_status(){
+    int status = last_status();
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+void start(){
+    READER reader = {.input = stdin, .history = history.path != NULL, .edit = INTERACTIVE && isatty(STDOUT_FILENO)};
+    SCRIPT script = {0};
+    int status;
+    //Loops until the exit command is typed into shell terminal (returning 0).
+    do {
+        //Announces the background jobs that finished.
+        notify_jobs();
+        //Prints the command prompt (only for the terminal).
+        if(INTERACTIVE)
+            printf("%s",return_var_value("PROMPT"));
+        //Reads and tokenizes a line (with the lines it continues on), stopping at the end of the input.
+        if(!read_statement(&reader))
+            break;
+        //Adds the statement to the history.
+        if(reader.history)
+            add_history(reader.text, reader.length);
+        //Parses line.
+        parse_tokens(&reader.tokens, &script);
+        //Executes line.
+        status = execute_script(&script);
+        //Empties the arena of the parse tree, keeping its memory for the next line.
+        reset_arena(&script.arena);
+    } while (status != 0);
+    free_arena(&script.arena);
+    free_reader(&reader);
+}
+
+//Executes every statement of a parsed script, returning 0 if one of them was the 'exit' command.
+int execute_script(SCRIPT *script){
+    return execute_list(script->statements);
+}
+
+//Executes a list of statements, returning 0 if one of them was the 'exit' command.
+//Stops early once a 'break', 'continue' or 'return' leaves the loop or function running the list.
+int execute_list(STATEMENT *statement){
+    for(;statement != NULL && !jumping();statement = statement->next){
+        if(execute_statement(statement) == 0)
+            return 0;
+    }
+    return 1;
+}
+
+//Executes a statement - compound commands run their parsed lists in the shell, without tokenizing or forking again.
+int execute_statement(STATEMENT *statement){
+    switch(statement->type){
+        case PIPELINE_STATEMENT:
+            return execute(&statement->pipeline);
+        case IF_STATEMENT:
+            if(execute_list(statement->condition) == 0)
+                return 0;
+            if(jumping())
+                return 1;
+            if(succeeded())
+                return execute_list(statement->body);
+            //Succeeds if no part runs, like other shells.
+            if(statement->otherwise == NULL){
+                set_exitcode(0);
+                return 1;
+            }
+            return execute_list(statement->otherwise);
+        case FOR_STATEMENT:
+            return execute_for(statement);
+        case GROUP_STATEMENT:
+            return execute_list(statement->body);
+        case FUNCTION_STATEMENT:
+            define_function(statement);
+            return 1;
+        default:
+            return execute_loop(statement);
+    }
+}
+
+//Executes a 'while' (or 'until') loop, running its body while the condition succeeds (or fails).
+int execute_loop(STATEMENT *statement){
+    int status = 1;
+    LOOP_DEPTH++;
+    while(status != 0){
+        status = execute_list(statement->condition);
+        if(status != 0 && !jumping()){
+            //Succeeds once the condition ends the loop, like other shells.
+            if(succeeded() != (statement->type == WHILE_STATEMENT)){
+                set_exitcode(0);
+                break;
+            }
+            status = execute_list(statement->body);
+        }
+        if(leave_loop())
+            break;
+    }
+    LOOP_DEPTH--;
+    return status;
+}
+
+//Executes a 'for' loop, setting its variable to each of its words (expanded once, before the first iteration).
+int execute_for(STATEMENT *statement){
+    //Copies the words, as a function running the loop could call itself and expand them again into the same buffer.
+    char **items = copy_args(build_args(statement->words, statement->word_count, statement->args, &statement->expansion));
+    int status = 1;
+    LOOP_DEPTH++;
+    for(int i=0;items[i]!=NULL && status!=0;i++){
+        assign_var(statement->variable, items[i]);
+        status = execute_list(statement->body);
+        if(leave_loop())
+            break;
+    }
+    LOOP_DEPTH--;
+    free(items);
+    if(statement->word_count == 0)
+        set_exitcode(0);
+    return status;
+}
+
+//Returns whether the last command succeeded (its exit code is 0).
+bool succeeded(){
+    return last_status() == 0;
+}
+
+//Returns whether a 'break', 'continue' or 'return' is skipping the statements after it.
+bool jumping(){
+    return LOOP_EXITS != 0 || RETURNING;
+}
+
+//Returns whether a loop has to stop after its body ran, because of a 'break', 'continue' or 'return'.
+//A 'continue' for this loop is done here, so the loop goes on to its next iteration.
+bool leave_loop(){
+    if(RETURNING)
+        return true;
+    if(LOOP_EXITS == 0)
+        return false;
+    if(LOOP_EXITS == 1 && LOOP_CONTINUE){
+        LOOP_EXITS = 0;
+        LOOP_CONTINUE = false;
+        return false;
+    }
+    LOOP_EXITS--;
+    return true;
+}
+
+//Executes a pipeline.
+int execute(PIPELINE *pipeline){
+    //Executes pipe commands, background jobs and external commands as jobs.
+    if(pipeline->count > 1 || pipeline->background || is_external(&pipeline->commands[0]))
+        return execute_pipe(pipeline);
+    //Executes internal commands (and assignments) with redirections in the shell, so they don't pay for a fork and their effects are kept.
+    if(pipeline->commands[0].redirect_count != 0)
+        return redirect_in_process(&pipeline->commands[0]);
+    return execute_command(&pipeline->commands[0]);
+}
+
+//Executes a command (without its redirections).
+int execute_command(COMMAND *command){
+    char **args = build_args(command->words, command->word_count, command->args, &command->expansion);
+    //Executes variable assignment.
+    if(command->type == ASSIGNMENT){
+        is_var_assignment(args[0]);
+        return 1;
+    }
+    //Executes internal commands, looking up names that came from a variable.
+    int builtin = command->builtin != -1 ? command->builtin : find_builtin(args[0]);
+    if(builtin != -1)
+        return builtins[builtin].function(args);
+    //Executes external commands.
+    launch(args);
+    return 1;
+}
+
+//Signal Handling function.
+void signals (int signal){
+    switch(signal) {
+        //If CTR-C is caught, terminate process.
+        case SIGINT:
+            printf("Signal %d caught.\n", signal);
+            exit(0); //Exits process.
+        //If CRT-Z is caught.
+        case SIGSTOP:
+            printf("Signal %d caught.\n", signal);
+            break;
+        default:
+            printf("Error - caught wrong signal.\n");
+    }
+}
+
+//Makes sure the token list can hold the text of a line of 'length' characters.
+void reserve_tokens(TOKENS *tokens, size_t length){
+    //Each word needs one extra byte for its '\0' (and a character gets at most one mark), so the text is at most twice as long as the line.
+    if(2 * length + 1 > tokens->text_capacity){
+        tokens->text_capacity = 2 * length + 1;
+        tokens->text = realloc(tokens->text, tokens->text_capacity);
+    }
+}
+
+//Adds a token to the token list, growing it geometrically, and returns it.
+TOKEN *add_token(TOKENS *tokens, TOKEN_TYPE type, char *text){
+    if(tokens->size == tokens->capacity){
+        tokens->capacity = tokens->capacity == 0 ? 64 : tokens->capacity * 2;
+        tokens->tokens = realloc(tokens->tokens, tokens->capacity * sizeof(TOKEN));
+        tokens->operators = realloc(tokens->operators, tokens->capacity * sizeof(int));
+    }
+    TOKEN *token = &tokens->tokens[tokens->size];
+    token->type = type;
+    token->text = text;
+    token->quoted = false;
+    token->expand = false;
+    //Remembers the position of operators.
+    if(type != WORD)
+        tokens->operators[tokens->op_count++] = tokens->size;
+    tokens->size++;
+    return token;
+}
+
+//Frees the buffers of a token list.
+void free_tokens(TOKENS *tokens){
+    free(tokens->tokens);
+    free(tokens->operators);
+    free(tokens->text);
+    memset(tokens, 0, sizeof(TOKENS));
+}
+
+//Tokenizes a line (or a whole script) in one pass, classifying operators and quoted strings, and returns the number of tokens.
+int lex_line(char *line, TOKENS *tokens){
+    reserve_tokens(tokens, strlen(line));
+    char *p = line, *text = tokens->text;
+    int line_start = 0;
+    //Whether a command would start at the next word (where reserved words are recognized), and the number of compound commands that did not end yet.
+    bool command = true;
+    int depth = 0, command_word = -1;
+    tokens->size = 0;
+    tokens->op_count = 0;
+    tokens->incomplete = false;
+    tokens->open_delimiter = NULL;
+    while(*p != '\0'){
+        //Joins a line ending with '\' to the next one (the statement is not complete if there is none yet).
+        if(p[0] == '\\' && p[1] == '\n'){
+            p += 2;
+            tokens->incomplete |= *p == '\0';
+            continue;
+        }
+        //Classifies operators, trying the longest one first.
+        if(*p == '\n'){
+            add_token(tokens, NEWLINE, "\n"), p += 1;
+            command = true;
+            //Reads the bodies of the 'HERE documents' started on the line from the lines after it.
+            for(int i=line_start;i+1<tokens->size;i++){
+                if(tokens->tokens[i].type == HERE_DOCUMENT && tokens->tokens[i+1].type == WORD)
+                    p = lex_here_document(p, &tokens->tokens[i+1], &text, tokens);
+            }
+            line_start = tokens->size;
+        } else if(strchr(DELIMITERS, *p) != NULL){
+            //Skips the delimiters between tokens.
+            p++;
+        } else if(*p == '|'){
+            add_token(tokens, PIPE, "|"), p += 1;
+            command = true;
+        } else if(*p == '&'){
+            add_token(tokens, BACKGROUND, "&"), p += 1;
+            command = true;
+        } else if(*p == ';'){
+            add_token(tokens, SEMICOLON, ";"), p += 1;
+            command = true;
+        } else if(strchr("<>", *p) != NULL){
+            //A redirection is followed by its file name.
+            command = false;
+            if(strncmp(p, ">>", 2) == 0){
+                add_token(tokens, APPEND_REDIRECT, ">>"), p += 2;
+            } else if(*p == '>'){
+                add_token(tokens, OUT_REDIRECT, ">"), p += 1;
+            } else if(strncmp(p, "<<<", 3) == 0){
+                add_token(tokens, HERE_STRING, "<<<"), p += 3;
+            } else if(strncmp(p, "<<", 2) == 0){
+                add_token(tokens, HERE_DOCUMENT, "<<"), p += 2;
+            } else if(*p == '<'){
+                add_token(tokens, IN_REDIRECT, "<"), p += 1;
+            }
+        } else {
+            //Copies a word into the token text, removing the quotes around quoted parts.
+            TOKEN *token = add_token(tokens, WORD, text);
+            while(*p != '\0' && strchr(DELIMITERS "|<>&;", *p) == NULL){
+                if(p[0] == '\\' && p[1] == '\n'){
+                    //Joins the word with its continuation on the next line.
+                    p += 2;
+                    tokens->incomplete |= *p == '\0';
+                } else if(is_substitution(p)){
+                    p = lex_substitution(p, &text, tokens);
+                } else if(*p == '\"' || *p == '\''){
+                    char quote = *p++;
+                    token->quoted = true;
+                    //Copies everything up to the closing quote (or the end of the line), with the substitutions in double quotes as they are.
+                    //A mark goes before every '$' or '`' in single quotes, and before a name character next to a quote, so neither is read as part of an expansion.
+                    for(bool first = true; *p != '\0' && *p != quote; first = false){
+                        if(quote == '\"' && is_substitution(p)){
+                            p = lex_substitution(p, &text, tokens);
+                            continue;
+                        }
+                        if((quote == '\'' && (*p == '$' || *p == '`')) || (first && (isalnum(*p) || *p == '_')))
+                            *text++ = LITERAL_MARK;
+                        *text++ = *p++;
+                    }
+                    if(*p == quote)
+                        p++;
+                    if(isalnum(*p) || *p == '_')
+                        *text++ = LITERAL_MARK;
+                } else {
+                    *text++ = *p++;
+                }
+            }
+            //Marks the words with variables or commands to expand, so the other words are used as they are.
+            bool marked = false;
+            for(char *c = token->text; c < text; c++){
+                if(*c == LITERAL_MARK)
+                    marked = true, c++;
+                else
+                    token->expand |= *c == '$' || *c == '`';
+            }
+            //Only expand_word() reads the marks, so they are removed from the other words.
+            if(marked && !token->expand){
+                char *to = token->text;
+                for(char *from = token->text; from < text; from++){
+                    if(*from != LITERAL_MARK)
+                        *to++ = *from;
+                }
+                text = to;
+            }
+            *text++ = '\0';
+            int t = tokens->size - 1;
+            //Splits the '()' off a function name ('name()'), so a '{' can start the body after it.
+            size_t size = text - 1 - token->text;
+            if(command && !token->quoted && size > 2 && strcmp(token->text + size - 2, "()") == 0 && name_length_of(token->text) == (int)size - 2){
+                token->text[size - 2] = '\0';
+                add_token(tokens, KEYWORD, "()");
+                continue;
+            }
+            //Marks the reserved words where a command would start (and the 'in' after 'for name', or the '()' after 'name'), counting the compound commands they open and close.
+            bool in = t >= 2 && tokens->tokens[t-2].type == KEYWORD && strcmp(tokens->tokens[t-2].text, "for") == 0
+                      && tokens->tokens[t-1].type == WORD && strcmp(token->text, "in") == 0;
+            bool function = t >= 1 && t - 1 == command_word && strcmp(token->text, "()") == 0;
+            if(token->quoted || !(in || function || (command && is_reserved(token->text)))){
+                command_word = command ? t : -1;
+                command = false;
+                continue;
+            }
+            token->type = KEYWORD;
+            tokens->operators[tokens->op_count++] = t;
+            if(is_reserved_start(token->text))
+                depth++;
+            else if(is_reserved_end(token->text) && depth > 0)
+                depth--;
+            //Every other reserved word (and the '()' of a function) is followed by a command.
+            command = strcmp(token->text, "in") != 0 && strcmp(token->text, "for") != 0 && !is_reserved_end(token->text);
+        }
+    }
+    //A 'HERE document' on the last line still needs its body.
+    for(int i=line_start;i<tokens->size;i++)
+        tokens->incomplete |= tokens->tokens[i].type == HERE_DOCUMENT;
+    //So does an 'if', a loop or a '{' without its 'fi', 'done' or '}'.
+    tokens->incomplete |= depth > 0;
+    //And a function whose body did not start yet.
+    int last = tokens->size - 1;
+    while(last >= 0 && tokens->tokens[last].type == NEWLINE)
+        last--;
+    tokens->incomplete |= last >= 0 && tokens->tokens[last].type == KEYWORD && strcmp(tokens->tokens[last].text, "()") == 0;
+    return tokens->size;
+}
+
+//Copies the command substitution or arithmetic expansion at 'p' into the token text as it is (with its spaces, quotes and operators), returning where it ends.
+char *lex_substitution(char *p, char **text, TOKENS *tokens){
+    char *end = substitution_end(p);
+    //The statement is not complete if it does not end.
+    if(end == NULL){
+        end = p + strlen(p);
+        tokens->incomplete = true;
+    }
+    memcpy(*text, p, end - p);
+    *text += end - p;
+    return end;
+}
+
+//Copies the lines up to 'delimiter' into the token text as the body of a 'HERE document', returning where the body ends.
+char *lex_here_document(char *p, TOKEN *delimiter, char **text, TOKENS *tokens){
+    char *body = *text;
+    size_t delimiter_length = strlen(delimiter->text);
+    //The body is not complete if the input ends before the delimiter.
+    tokens->incomplete = true;
+    tokens->open_delimiter = delimiter->text;
+    while(*p != '\0'){
+        size_t length = strcspn(p, "\n");
+        //Stops at a line holding only the delimiter.
+        if(length == delimiter_length && strncmp(p, delimiter->text, length) == 0){
+            p += p[length] == '\n' ? length + 1 : length;
+            tokens->incomplete = false;
+            tokens->open_delimiter = NULL;
+            break;
+        }
+        //Copies the line with its newline.
+        if(p[length] == '\n')
+            length++;
+        memcpy(*text, p, length);
+        *text += length;
+        p += length;
+    }
+    *(*text)++ = '\0';
+    //The body replaces the delimiter, and is expanded like a word in double quotes unless the delimiter was quoted ('EOF' or "EOF").
+    delimiter->expand = !delimiter->quoted && (strchr(body, '$') != NULL || strchr(body, '`') != NULL);
+    delimiter->text = body;
+    delimiter->quoted = true;
+    return p;
+}
+
+//Builds the NULL-terminated argument array of a list of words, expanding the words with variables into 'expansion'.
+char **build_args(TOKEN *words, int count, char **args, EXPANSION *expansion){
+    //Expands every word first, as the buffer may move while it grows.
+    size_t length = 0, offsets[count + 1];
+    for(int i=0;i<count;i++){
+        offsets[i] = length;
+        if(words[i].expand)
+            length = expand_word(words[i].text, expansion, length);
+    }
+    for(int i=0;i<count;i++)
+        args[i] = words[i].expand ? expansion->text + offsets[i] : words[i].text;
+    args[count] = NULL;
+    return args;
+}
+
+//Writes a word to 'expansion' at 'length' in one pass, replacing every '$name' and '${name}' with the value of the variable (or nothing if it is not set),
+//every '$((expression))' with its integer value, and every '$(commands)' or '`commands`' with their output.
+//Returns the length of the buffer after the expanded word and its '\0'.
+size_t expand_word(char *word, EXPANSION *expansion, size_t length){
+    char *p = word;
+    while(*p != '\0'){
+        //Copies the text up to the next '$', '`' or LITERAL_MARK.
+        size_t run = strcspn(p, "$`\001");
+        reserve_expansion(expansion, length + run + 2);
+        memcpy(expansion->text + length, p, run);
+        length += run;
+        p += run;
+        if(*p == '\0')
+            break;
+        //Keeps a marked character as it is.
+        if(*p == LITERAL_MARK){
+            expansion->text[length++] = p[1];
+            p += 2;
+            continue;
+        }
+        //Replaces an arithmetic expansion with its value, which has to end at its closing '))'.
+        if(strncmp(p, "$((", 3) == 0){
+            char *end = substitution_end(p), *q = p + 3, *limit = end == NULL ? NULL : end - 2, *expression = NULL;
+            bool error = end == NULL;
+            //Substitutes the commands in the expression first, evaluating a copy of it (variables are read by the evaluation itself).
+            if(!error && (memchr(q, '`', limit - q) != NULL || memmem(q, limit - q, "$(", 2) != NULL)){
+                char *text = strndup(q, limit - q);
+                expand_word(text, expansion, length);
+                q = expression = strdup(expansion->text + length);
+                limit = expression + strlen(expression);
+                free(text);
+            }
+            long long value = error ? 0 : evaluate_arithmetic(&q, 0, &error);
+            while(!error && isspace(*q))
+                q++;
+            if(error || q != limit){
+                fprintf(stderr,"Error -- Invalid arithmetic expression \'%.*s\'.\n", (int)(end == NULL ? strlen(p) : end - p), p);
+            } else {
+                reserve_expansion(expansion, length + 24);
+                length += sprintf(expansion->text + length, "%lld", value);
+            }
+            free(expression);
+            p = end == NULL ? p + strlen(p) : end;
+            continue;
+        }
+        //Replaces a command substitution with the output of the commands (running up to the end of the word if it does not end).
+        if(is_substitution(p)){
+            char *end = substitution_end(p), *command = p + (*p == '`' ? 1 : 2);
+            if(end == NULL)
+                end = p + strlen(p);
+            size_t size = end - command;
+            if(size > 0 && end[-1] == (*p == '`' ? '`' : ')'))
+                size--;
+            char *text = strndup(command, size);
+            length = command_substitution(text, expansion, length);
+            free(text);
+            p = end;
+            continue;
+        }
+        //Finds the name after the '$', either in braces, as one digit or '#', '@' or '*' (the parameters of a function), or as the longest run of name characters.
+        char *name = p + 1, *end;
+        size_t name_length;
+        if(*name == '{' && (end = strchr(name, '}')) != NULL){
+            name_length = end - ++name;
+            end++;
+        } else if(isdigit(*name) || (*name != '\0' && strchr("#@*", *name) != NULL)){
+            name_length = 1;
+            end = name + 1;
+        } else {
+            name_length = name_length_of(name);
+            end = name + name_length;
+        }
+        //Keeps a '$' that is not followed by a name.
+        if(name_length == 0){
+            expansion->text[length++] = *p++;
+            continue;
+        }
+        char *value = lookup_var(name, name_length);
+        if(value != NULL){
+            size_t size = strlen(value);
+            reserve_expansion(expansion, length + size + 1);
+            memcpy(expansion->text + length, value, size);
+            length += size;
+        }
+        p = end;
+    }
+    reserve_expansion(expansion, length + 1);
+    expansion->text[length++] = '\0';
+    return length;
+}
+
+//Runs the commands of a command substitution, writing their output (without its trailing newlines) to 'expansion' at 'length', and returns the length after it.
+//Internal commands that only write output run in the shell, and anything else in a forked shell writing to a pipe.
+size_t command_substitution(char *text, EXPANSION *expansion, size_t length){
+    TOKENS tokens = {0};
+    SCRIPT script = {0};
+    size_t start = length;
+    lex_line(text, &tokens);
+    parse_tokens(&tokens, &script);
+    if(substitute_in_process(script.statements)){
+        //Writes to a memory file rather than a pipe, which could fill up as nothing reads it while the commands run.
+        int fd = memfd_create("substitution", MFD_CLOEXEC);
+        if(fd == -1){
+            perror("Error -- memfd_create()");
+        } else {
+            fflush(stdout);
+            int saved = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+            dup2(fd, STDOUT_FILENO);
+            execute_script(&script);
+            fflush(stdout);
+            dup2(saved, STDOUT_FILENO);
+            close(saved);
+            lseek(fd, 0, SEEK_SET);
+            length = read_output(fd, expansion, length);
+            close(fd);
+        }
+    } else {
+        int fds[2];
+        if(pipe2(fds, O_CLOEXEC) == -1){
+            perror("Error -- pipe()");
+        } else {
+            JOB *job = new_job(NULL, NULL, 1);
+            pid_t pid = fork_process(-1);
+            if(pid == 0){
+                //Runs the commands without job control, so they don't take the terminal from the shell.
+                JOB_CONTROL = false;
+                dup2(fds[1], STDOUT_FILENO);
+                set_exitcode(0);
+                execute_script(&script);
+                fflush(stdout);
+                _exit(exit_status());
+            }
+            if(pid == -1)
+                perror("Error -- fork()");
+            close(fds[1]);
+            add_job_process(job, pid);
+            //Reads the output while the commands run, then sets the exit code to theirs.
+            length = read_output(fds[0], expansion, length);
+            close(fds[0]);
+            set_exitcode(wait_job(job, false));
+        }
+    }
+    while(length > start && expansion->text[length - 1] == '\n')
+        length--;
+    free_tokens(&tokens);
+    free_arena(&script.arena);
+    return length;
+}
+
+//Returns whether a command substitution only runs internal commands that write output (changing nothing in the shell), so it can run without forking.
+bool substitute_in_process(STATEMENT *statement){
+    for(;statement != NULL;statement = statement->next){
+        if(statement->type != PIPELINE_STATEMENT || statement->pipeline.count != 1 || statement->pipeline.background
+           || statement->pipeline.commands[0].type != BUILTIN)
+            return false;
+        int (*function)(char **) = builtins[statement->pipeline.commands[0].builtin].function;
+        bool output = false;
+        for(int i=0;OUTPUT_BUILTINS[i]!=NULL;i++)
+            output |= function == OUTPUT_BUILTINS[i];
+        if(!output)
+            return false;
+    }
+    return true;
+}
+
+//Reads a descriptor up to its end into 'expansion' at 'length', growing the buffer as needed, and returns the length after the data.
+size_t read_output(int fd, EXPANSION *expansion, size_t length){
+    ssize_t n;
+    do {
+        reserve_expansion(expansion, length + 4096 + 1);
+        n = read(fd, expansion->text + length, expansion->capacity - length - 1);
+        if(n > 0)
+            length += n;
+    } while(n > 0 || (n == -1 && errno == EINTR));
+    return length;
+}
+
+//Makes sure an expansion buffer can hold 'size' bytes, moving it to a larger space of its arena (keeping its contents) if it cannot.
+void reserve_expansion(EXPANSION *expansion, size_t size){
+    if(size <= expansion->capacity)
+        return;
+    size_t capacity = expansion->capacity == 0 ? 64 : expansion->capacity * 2;
+    while(capacity < size)
+        capacity *= 2;
+    char *text = arena_alloc(expansion->arena, capacity);
+    if(expansion->text != NULL)
+        memcpy(text, expansion->text, expansion->capacity);
+    expansion->arena->garbage += expansion->capacity;
+    expansion->text = text;
+    expansion->capacity = capacity;
+}
+
+//Returns whether a word is reserved (where a command would start).
+bool is_reserved(char *word){
+    for(int i=0;KEYWORDS[i]!=NULL;i++){
+        if(strcmp(word, KEYWORDS[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+//Returns whether a reserved word starts a compound command (ending with 'fi', 'done' or '}').
+bool is_reserved_start(char *word){
+    return strcmp(word, "if") == 0 || strcmp(word, "while") == 0 || strcmp(word, "until") == 0 || strcmp(word, "for") == 0 || strcmp(word, "{") == 0;
+}
+
+//Returns whether a reserved word ends a compound command.
+bool is_reserved_end(char *word){
+    return strcmp(word, "fi") == 0 || strcmp(word, "done") == 0 || strcmp(word, "}") == 0;
+}
+
+//Returns whether a command substitution ('$(...)' or '`...`') or an arithmetic expansion ('$((...))') starts at 'p'.
+bool is_substitution(char *p){
+    return (p[0] == '$' && p[1] == '(') || p[0] == '`';
+}
+
+//Returns the end of the substitution or arithmetic expansion starting at 'p' (just after its closing ')' or '`'), or NULL if it does not end.
+char *substitution_end(char *p){
+    if(*p == '`'){
+        char *end = strchr(p + 1, '`');
+        return end == NULL ? NULL : end + 1;
+    }
+    //Counts the parentheses from the one after '$', skipping the ones in quotes.
+    int depth = 0;
+    for(p++;*p != '\0';p++){
+        if(*p == '\'' || *p == '\"'){
+            if((p = strchr(p + 1, *p)) == NULL)
+                return NULL;
+        } else if(*p == '('){
+            depth++;
+        } else if(*p == ')' && --depth == 0){
+            return p + 1;
+        }
+    }
+    return NULL;
+}
+
+//Evaluates the integer expression at '*p' up to the first operator binding no tighter than 'precedence' (0 for the whole expression), moving '*p' past it.
+//Sets 'error' on a syntax error or a division by zero.
+long long evaluate_arithmetic(char **p, int precedence, bool *error){
+    long long value = arithmetic_operand(p, error);
+    int length, next;
+    while(!*error){
+        while(isspace(**p))
+            (*p)++;
+        //Evaluates the right side of the operator first if its operators bind tighter (so equal ones go from left to right).
+        if((next = arithmetic_operator(*p, &length)) <= precedence)
+            break;
+        char *op = *p;
+        *p += length;
+        long long right = evaluate_arithmetic(p, next, error);
+        value = apply_arithmetic(op, length, value, right, error);
+    }
+    return value;
+}
+
+//Evaluates a number, a variable ('name', '$name' or '${name}', 0 if it is not set, or a parameter like '$1'), an expression in parentheses, or an operand after a unary operator.
+long long arithmetic_operand(char **p, bool *error){
+    while(isspace(**p))
+        (*p)++;
+    char c = **p;
+    if(c == '('){
+        (*p)++;
+        long long value = evaluate_arithmetic(p, 0, error);
+        while(isspace(**p))
+            (*p)++;
+        if(**p != ')')
+            *error = true;
+        else
+            (*p)++;
+        return value;
+    }
+    if(c == '-' || c == '+' || c == '!' || c == '~'){
+        (*p)++;
+        long long value = arithmetic_operand(p, error);
+        return c == '-' ? (long long)(0ULL - value) : c == '!' ? !value : c == '~' ? ~value : value;
+    }
+    //Numbers may be octal ('0' first) or hexadecimal ('0x' first).
+    if(isdigit(c))
+        return strtoll(*p, p, 0);
+    char *name = *p;
+    bool braces = false;
+    if(*name == '$' && *++name == '{'){
+        name++;
+        braces = true;
+    }
+    //After a '$', the name may also be a positional parameter or '#'.
+    int length = braces ? (int)strcspn(name, "}") : (name > *p && (isdigit(*name) || *name == '#')) ? 1 : name_length_of(name);
+    if(length == 0 || (braces && name[length] != '}')){
+        *error = true;
+        return 0;
+    }
+    *p = name + length + braces;
+    char *value = lookup_var(name, length);
+    return value == NULL ? 0 : strtoll(value, NULL, 0);
+}
+
+//Returns the precedence of the binary operator at 'p' (higher binds tighter, 0 if there is none) and sets its length.
+int arithmetic_operator(char *p, int *length){
+    *length = 2;
+    if(strncmp(p, "||", 2) == 0)
+        return 1;
+    if(strncmp(p, "&&", 2) == 0)
+        return 2;
+    if(strncmp(p, "==", 2) == 0 || strncmp(p, "!=", 2) == 0)
+        return 6;
+    if(strncmp(p, "<=", 2) == 0 || strncmp(p, ">=", 2) == 0)
+        return 7;
+    if(strncmp(p, "<<", 2) == 0 || strncmp(p, ">>", 2) == 0)
+        return 8;
+    *length = 1;
+    switch(*p){
+        case '|': return 3;
+        case '^': return 4;
+        case '&': return 5;
+        case '<': case '>': return 7;
+        case '+': case '-': return 9;
+        case '*': case '/': case '%': return 10;
+        default: return 0;
+    }
+}
+
+//Applies a binary operator (wrapping around on overflow, like other shells).
+long long apply_arithmetic(char *op, int length, long long a, long long b, bool *error){
+    unsigned long long x = a, y = b;
+    if(length == 2){
+        switch(op[0]){
+            case '|': return a || b;
+            case '&': return a && b;
+            case '=': return a == b;
+            case '!': return a != b;
+            case '<': return op[1] == '=' ? a <= b : (long long)(x << (y & 63));
+            default: return op[1] == '=' ? a >= b : a >> (y & 63);
+        }
+    }
+    switch(op[0]){
+        case '|': return a | b;
+        case '^': return a ^ b;
+        case '&': return a & b;
+        case '<': return a < b;
+        case '>': return a > b;
+        case '+': return (long long)(x + y);
+        case '-': return (long long)(x - y);
+        case '*': return (long long)(x * y);
+    }
+    //Dividing by zero is an error, and dividing the smallest number by -1 would overflow.
+    if(b == 0){
+        *error = true;
+        return 0;
+    }
+    if(b == -1)
+        return op[0] == '/' ? (long long)(0ULL - x) : 0;
+    return op[0] == '/' ? a / b : a % b;
+}
+
+/* ------------------- PARSE TREE --------------------- */
+
+//Returns the index of an internal command in 'builtins', or -1 if it is not one.
+//The hash of the builtins has no collisions, so a name is only compared with the one builtin in its slot.
+int find_builtin(char *name){
+    if(BUILTIN_HASH_SIZE == 0)
+        return -1;
+    int i = builtin_hash[builtin_slot(name, BUILTIN_SEED)];
+    return (i != -1 && strcmp(name, builtins[i].name) == 0) ? i : -1;
+}
+
+//Returns the slot of a name in the builtin hash for a seed (FNV-1a starting from a seeded offset).
+int builtin_slot(char *name, unsigned int seed){
+    unsigned int hash = 2166136261u ^ seed;
+    while(*name != '\0'){
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash & (BUILTIN_HASH_SIZE - 1);
+}
+
+//Registers the internal commands the shell starts with.
+void init_builtins(){
+    //Hashes the names once, instead of once per command as register_builtin() would (the seed search dominates the start of the shell).
+    BUILTIN_COUNT = sizeof(default_builtins)/sizeof(BUILTIN_COMMAND);
+    builtins = realloc(builtins, BUILTIN_COUNT * sizeof(BUILTIN_COMMAND));
+    memcpy(builtins, default_builtins, sizeof(default_builtins));
+    hash_builtins();
+}
+
+//Adds an internal command (or replaces the one with the same name) and returns its index.
+//Indices never change, so parse trees that already looked a name up stay valid.
+int register_builtin(char *name, int (*function)(char **)){
+    int i = find_builtin(name);
+    if(i == -1){
+        builtins = realloc(builtins, (BUILTIN_COUNT + 1) * sizeof(BUILTIN_COMMAND));
+        i = BUILTIN_COUNT++;
+    }
+    builtins[i].name = name;
+    builtins[i].function = function;
+    builtins[i].script = NULL;
+    hash_builtins();
+    return i;
+}
+
+//Rebuilds the builtin hash, searching for a seed that gives every name a slot of its own (doubling the table if none is found).
+void hash_builtins(){
+    if(BUILTIN_HASH_SIZE == 0)
+        BUILTIN_HASH_SIZE = 16;
+    while(BUILTIN_HASH_SIZE < 2 * BUILTIN_COUNT)
+        BUILTIN_HASH_SIZE *= 2;
+    for(;;BUILTIN_HASH_SIZE *= 2){
+        builtin_hash = realloc(builtin_hash, BUILTIN_HASH_SIZE * sizeof(int));
+        for(unsigned int seed=0;seed<256;seed++){
+            int placed = 0;
+            memset(builtin_hash, -1, BUILTIN_HASH_SIZE * sizeof(int));
+            while(placed < BUILTIN_COUNT){
+                int slot = builtin_slot(builtins[placed].name, seed);
+                if(builtin_hash[slot] != -1)
+                    break;
+                builtin_hash[slot] = placed++;
+            }
+            if(placed == BUILTIN_COUNT){
+                BUILTIN_SEED = seed;
+                return;
+            }
+        }
+    }
+}
+
+//Copies a word into the arena of a script.
+void copy_word(SCRIPT *script, TOKEN *to, TOKEN *from){
+    *to = *from;
+    to->text = arena_strdup(&script->arena, from->text);
+}
+
+//Copies a list of statements (and everything in them) into the arena of another script, e.g. the body of a function that outlives the line defining it.
+STATEMENT *copy_statements(SCRIPT *script, STATEMENT *from){
+    STATEMENT *first = NULL, **last = &first;
+    for(;from != NULL;from = from->next){
+        STATEMENT *to = arena_new(&script->arena, sizeof(STATEMENT));
+        *to = *from;
+        to->condition = copy_statements(script, from->condition);
+        to->body = copy_statements(script, from->body);
+        to->otherwise = copy_statements(script, from->otherwise);
+        to->next = NULL;
+        if(from->variable != NULL)
+            to->variable = arena_strdup(&script->arena, from->variable);
+        if(from->type == FOR_STATEMENT)
+            to->words = copy_words(script, from->words, from->word_count, &to->args, &to->expansion);
+        //Copies every command of a pipeline with its redirections.
+        if(from->type == PIPELINE_STATEMENT){
+            to->pipeline.commands = arena_new(&script->arena, from->pipeline.count * sizeof(COMMAND));
+            for(int c=0;c<from->pipeline.count;c++){
+                COMMAND *command = &to->pipeline.commands[c], *original = &from->pipeline.commands[c];
+                *command = *original;
+                command->words = copy_words(script, original->words, original->word_count, &command->args, &command->expansion);
+                command->redirects = arena_new(&script->arena, original->redirect_count * sizeof(REDIRECT));
+                for(int r=0;r<original->redirect_count;r++){
+                    REDIRECT *redirect = &command->redirects[r];
+                    *redirect = original->redirects[r];
+                    redirect->words = copy_words(script, redirect->words, redirect->word_count, &redirect->args, &redirect->expansion);
+                }
+            }
+        }
+        *last = to;
+        last = &to->next;
+    }
+    return first;
+}
+
+//Copies a list of words into the arena of a script, with new space for their expanded words.
+TOKEN *copy_words(SCRIPT *script, TOKEN *from, int count, char ***args, EXPANSION *expansion){
+    TOKEN *words = arena_new(&script->arena, count * sizeof(TOKEN));
+    for(int w=0;w<count;w++)
+        copy_word(script, &words[w], &from[w]);
+    *args = arena_new(&script->arena, (count + 1) * sizeof(char *));
+    *expansion = (EXPANSION){&script->arena, NULL, 0};
+    return words;
+}
+
+//Parses the tokens from 'start' to 'end' (which only contain redirection operators) into a command.
+int parse_command(TOKENS *tokens, int start, int end, int redirect_count, SCRIPT *script, COMMAND *command){
+    command->words = arena_new(&script->arena, (end - start) * sizeof(TOKEN));
+    command->word_count = 0;
+    command->redirects = arena_new(&script->arena, redirect_count * sizeof(REDIRECT));
+    command->redirect_count = 0;
+    for(int i=start;i<end;i++){
+        TOKEN *token = &tokens->tokens[i];
+        if(token->type == WORD){
+            copy_word(script, &command->words[command->word_count++], token);
+            continue;
+        }
+        //A redirection takes the next word (the file name, or the body of a 'HERE document'), or every word up to the next operator for a 'HERE string'.
+        REDIRECT *redirect = &command->redirects[command->redirect_count++];
+        redirect->type = token->type;
+        redirect->word_count = 0;
+        int words = 0;
+        while(i + 1 + words < end && tokens->tokens[i + 1 + words].type == WORD && (words == 0 || token->type == HERE_STRING))
+            words++;
+        if(words == 0){
+            fprintf(stderr,"Error -- No arguments inputted after the operator \'%s\'.\n", token->text);
+            return 0;
+        }
+        redirect->words = arena_new(&script->arena, words * sizeof(TOKEN));
+        redirect->args = arena_new(&script->arena, (words + 1) * sizeof(char *));
+        redirect->expansion = (EXPANSION){&script->arena, NULL, 0};
+        for(int w=0;w<words;w++)
+            copy_word(script, &redirect->words[redirect->word_count++], &tokens->tokens[++i]);
+    }
+    if(command->word_count == 0){
+        fprintf(stderr,"Error -- No command inputted before or after an operator.\n");
+        return 0;
+    }
+    command->args = arena_new(&script->arena, (command->word_count + 1) * sizeof(char *));
+    command->expansion = (EXPANSION){&script->arena, NULL, 0};
+    //Classifies the command, looking up internal commands once here instead of every time it runs.
+    command->builtin = -1;
+    if(assignment_name_length(command->words[0].text) != 0){
+        command->type = ASSIGNMENT;
+    } else if((command->builtin = find_builtin(command->words[0].text)) != -1){
+        command->type = BUILTIN;
+    } else {
+        command->type = EXTERNAL;
+    }
+    return 1;
+}
+
+//Parses a token list into the statements of a script, skipping statements with syntax errors.
+int parse_tokens(TOKENS *tokens, SCRIPT *script){
+    PARSER parser = {tokens, 0, 0, script};
+    STATEMENT **last = &script->statements;
+    script->statements = NULL;
+    script->count = 0;
+    while(parser.position < tokens->size){
+        int start = parser.position;
+        bool valid = true;
+        STATEMENT *list = parse_list(&parser, &valid);
+        //Stops at a reserved word that does not start a statement, e.g. a 'done' without a loop.
+        if(valid && parser.position < tokens->size){
+            fprintf(stderr,"Error -- Unexpected \'%s\'.\n", tokens->tokens[parser.position].text);
+            valid = false;
+        }
+        if(!valid){
+            parser.position = start;
+            skip_statement(&parser);
+            continue;
+        }
+        //Adds the statements to the end of the script.
+        for(*last = list;*last != NULL;last = &(*last)->next)
+            script->count++;
+    }
+    return script->count;
+}
+
+//Parses statements (separated by newlines, ';' or '&') up to a reserved word that does not start one (or the end of the tokens), returning the first.
+//Sets 'valid' to false if there is a syntax error.
+STATEMENT *parse_list(PARSER *parser, bool *valid){
+    TOKENS *tokens = parser->tokens;
+    STATEMENT *first = NULL, **last = &first;
+    while(parser->position < tokens->size){
+        TOKEN *token = &tokens->tokens[parser->position];
+        //Skips empty statements.
+        if(token->type == NEWLINE || token->type == SEMICOLON){
+            parser->position++;
+            continue;
+        }
+        if(token->type == KEYWORD && !is_reserved_start(token->text))
+            break;
+        if((*last = parse_statement(parser)) == NULL){
+            *valid = false;
+            return NULL;
+        }
+        last = &(*last)->next;
+        //A statement ends at a newline, ';' or '&' (or at the reserved word ending the list).
+        if(parser->position < tokens->size && tokens->tokens[parser->position - 1].type != BACKGROUND){
+            token = &tokens->tokens[parser->position];
+            if(token->type != NEWLINE && token->type != SEMICOLON && token->type != KEYWORD){
+                fprintf(stderr,"Error -- Unexpected \'%s\' after \'%s\'.\n", token->text, tokens->tokens[parser->position - 1].text);
+                *valid = false;
+                return NULL;
+            }
+        }
+    }
+    return first;
+}
+
+//Parses a statement - a pipeline, a function definition, or a compound command started by a reserved word - returning NULL if it has a syntax error.
+STATEMENT *parse_statement(PARSER *parser){
+    TOKENS *tokens = parser->tokens;
+    TOKEN *token = &tokens->tokens[parser->position];
+    if(token->type == KEYWORD){
+        if(strcmp(token->text, "if") == 0)
+            return parse_if(parser);
+        if(strcmp(token->text, "for") == 0)
+            return parse_for(parser);
+        if(strcmp(token->text, "{") == 0)
+            return parse_group(parser);
+        return parse_loop(parser);
+    }
+    if(parser->position + 1 < tokens->size && tokens->tokens[parser->position + 1].type == KEYWORD
+       && strcmp(tokens->tokens[parser->position + 1].text, "()") == 0)
+        return parse_function(parser);
+    STATEMENT *statement = new_statement(parser, PIPELINE_STATEMENT);
+    return parse_pipeline(parser, &statement->pipeline) ? statement : NULL;
+}
+
+//Parses a pipeline, ending at a newline, ';', '&' or reserved word, returning 0 if it has a syntax error.
+int parse_pipeline(PARSER *parser, PIPELINE *pipeline){
+    TOKENS *tokens = parser->tokens;
+    //Finds the end of the pipeline and counts its stages using the operator positions.
+    int end = tokens->size, stages = 1, first_op = next_operator(parser);
+    for(int op=first_op;op<tokens->op_count;op++){
+        TOKEN_TYPE type = tokens->tokens[tokens->operators[op]].type;
+        if(type == NEWLINE || type == SEMICOLON || type == BACKGROUND || type == KEYWORD){
+            end = tokens->operators[op];
+            break;
+        }
+        stages += type == PIPE;
+    }
+    pipeline->commands = arena_new(&parser->script->arena, stages * sizeof(COMMAND));
+    pipeline->count = 0;
+    pipeline->background = end < tokens->size && tokens->tokens[end].type == BACKGROUND;
+    //Parses every stage between the pipes, counting the redirections in each one.
+    int stage_start = parser->position, redirects = 0;
+    for(int o=first_op;;o++){
+        int position = o < tokens->op_count ? tokens->operators[o] : end;
+        if(position >= end){
+            position = end;
+        } else if(tokens->tokens[position].type != PIPE){
+            redirects++;
+            continue;
+        }
+        if(!parse_command(tokens, stage_start, position, redirects, parser->script, &pipeline->commands[pipeline->count++]))
+            return 0;
+        if(position == end)
+            break;
+        stage_start = position + 1;
+        redirects = 0;
+    }
+    //Moves past the pipeline (and its '&').
+    parser->position = pipeline->background ? end + 1 : end;
+    return 1;
+}
+
+//Parses 'if list; then list; [elif list; then list;]... [else list;] fi'.
+STATEMENT *parse_if(PARSER *parser){
+    STATEMENT *statement = new_statement(parser, IF_STATEMENT);
+    bool valid = true;
+    parser->position++;
+    statement->condition = parse_list(parser, &valid);
+    if(!valid || !expect_condition(parser, statement) || !expect_keyword(parser, "then"))
+        return NULL;
+    statement->body = parse_list(parser, &valid);
+    if(!valid)
+        return NULL;
+    //An 'elif' is parsed as an 'if' in the 'else' part, which ends at the same 'fi'.
+    if(is_keyword(parser, "elif")){
+        if((statement->otherwise = parse_if(parser)) == NULL)
+            return NULL;
+        return statement;
+    }
+    if(is_keyword(parser, "else")){
+        parser->position++;
+        statement->otherwise = parse_list(parser, &valid);
+        if(!valid)
+            return NULL;
+    }
+    return expect_keyword(parser, "fi") ? statement : NULL;
+}
+
+//Parses 'while list; do list; done' (or the same with 'until').
+STATEMENT *parse_loop(PARSER *parser){
+    TOKEN *keyword = &parser->tokens->tokens[parser->position++];
+    STATEMENT *statement = new_statement(parser, strcmp(keyword->text, "while") == 0 ? WHILE_STATEMENT : UNTIL_STATEMENT);
+    bool valid = true;
+    statement->condition = parse_list(parser, &valid);
+    if(!valid || !expect_condition(parser, statement) || !expect_keyword(parser, "do"))
+        return NULL;
+    statement->body = parse_list(parser, &valid);
+    return valid && expect_keyword(parser, "done") ? statement : NULL;
+}
+
+//Parses 'for name in words; do list; done'.
+STATEMENT *parse_for(PARSER *parser){
+    TOKENS *tokens = parser->tokens;
+    SCRIPT *script = parser->script;
+    STATEMENT *statement = new_statement(parser, FOR_STATEMENT);
+    bool valid = true;
+    int name = ++parser->position;
+    if(name >= tokens->size || tokens->tokens[name].type != WORD || name_length_of(tokens->tokens[name].text) != (int)strlen(tokens->tokens[name].text)){
+        fprintf(stderr,"Error -- Expected a variable name after \'for\'.\n");
+        return NULL;
+    }
+    statement->variable = arena_strdup(&script->arena, tokens->tokens[name].text);
+    parser->position++;
+    if(!expect_keyword(parser, "in"))
+        return NULL;
+    //Copies the words up to the end of the line (or ';').
+    int count = 0;
+    while(parser->position + count < tokens->size && tokens->tokens[parser->position + count].type == WORD)
+        count++;
+    statement->words = arena_new(&script->arena, count * sizeof(TOKEN));
+    statement->word_count = count;
+    statement->args = arena_new(&script->arena, (count + 1) * sizeof(char *));
+    statement->expansion = (EXPANSION){&script->arena, NULL, 0};
+    for(int w=0;w<count;w++)
+        copy_word(script, &statement->words[w], &tokens->tokens[parser->position++]);
+    //Skips the newlines and ';' before 'do'.
+    while(parser->position < tokens->size && (tokens->tokens[parser->position].type == NEWLINE || tokens->tokens[parser->position].type == SEMICOLON))
+        parser->position++;
+    if(!expect_keyword(parser, "do"))
+        return NULL;
+    statement->body = parse_list(parser, &valid);
+    return valid && expect_keyword(parser, "done") ? statement : NULL;
+}
+
+//Parses '{ list; }'.
+STATEMENT *parse_group(PARSER *parser){
+    STATEMENT *statement = new_statement(parser, GROUP_STATEMENT);
+    bool valid = true;
+    parser->position++;
+    statement->body = parse_list(parser, &valid);
+    return valid && expect_keyword(parser, "}") ? statement : NULL;
+}
+
+//Parses 'name() { list; }', where the '{' may be on the next line.
+STATEMENT *parse_function(PARSER *parser){
+    TOKENS *tokens = parser->tokens;
+    char *name = tokens->tokens[parser->position].text;
+    if(name_length_of(name) != (int)strlen(name)){
+        fprintf(stderr,"Error -- \'%s\' is not a valid function name.\n", name);
+        return NULL;
+    }
+    STATEMENT *statement = new_statement(parser, FUNCTION_STATEMENT);
+    statement->variable = arena_strdup(&parser->script->arena, name);
+    parser->position += 2;
+    while(parser->position < tokens->size && tokens->tokens[parser->position].type == NEWLINE)
+        parser->position++;
+    bool valid = true;
+    if(!expect_keyword(parser, "{"))
+        return NULL;
+    statement->body = parse_list(parser, &valid);
+    return valid && expect_keyword(parser, "}") ? statement : NULL;
+}
+
+//Allocates an empty statement in the arena of the script.
+STATEMENT *new_statement(PARSER *parser, STATEMENT_TYPE type){
+    STATEMENT *statement = arena_new(&parser->script->arena, sizeof(STATEMENT));
+    memset(statement, 0, sizeof(STATEMENT));
+    statement->type = type;
+    return statement;
+}
+
+//Returns false (with an error) if an 'if' or a loop has no condition.
+bool expect_condition(PARSER *parser, STATEMENT *statement){
+    if(statement->condition != NULL)
+        return true;
+    fprintf(stderr,"Error -- No condition inputted after \'%s\'.\n", statement->type == IF_STATEMENT ? "if" : statement->type == WHILE_STATEMENT ? "while" : "until");
+    return false;
+}
+
+//Moves past a reserved word, returning false (with an error) if it is not the next token.
+bool expect_keyword(PARSER *parser, char *keyword){
+    if(is_keyword(parser, keyword)){
+        parser->position++;
+        return true;
+    }
+    if(parser->position < parser->tokens->size)
+        fprintf(stderr,"Error -- Expected \'%s\' before \'%s\'.\n", keyword, parser->tokens->tokens[parser->position].text);
+    else
+        fprintf(stderr,"Error -- Expected \'%s\' before the end of the input.\n", keyword);
+    return false;
+}
+
+//Returns whether the next token is the reserved word 'keyword'.
+bool is_keyword(PARSER *parser, char *keyword){
+    TOKENS *tokens = parser->tokens;
+    return parser->position < tokens->size && tokens->tokens[parser->position].type == KEYWORD
+           && strcmp(tokens->tokens[parser->position].text, keyword) == 0;
+}
+
+//Returns the index of the first operator at or after the parser's position, moving the operator cursor to it.
+int next_operator(PARSER *parser){
+    TOKENS *tokens = parser->tokens;
+    while(parser->op > 0 && tokens->operators[parser->op - 1] >= parser->position)
+        parser->op--;
+    while(parser->op < tokens->op_count && tokens->operators[parser->op] < parser->position)
+        parser->op++;
+    return parser->op;
+}
+
+//Skips a statement with a syntax error - up to the end of its line, or of the compound command it starts.
+void skip_statement(PARSER *parser){
+    TOKENS *tokens = parser->tokens;
+    int depth = 0;
+    for(;parser->position < tokens->size;parser->position++){
+        TOKEN *token = &tokens->tokens[parser->position];
+        if(token->type == NEWLINE && depth == 0)
+            break;
+        if(token->type == KEYWORD && is_reserved_start(token->text))
+            depth++;
+        else if(token->type == KEYWORD && is_reserved_end(token->text) && depth > 0)
+            depth--;
+    }
+    parser->position++;
+}
+
+//Returns the parsed script of a file, given its 'stat()' information, parsing it only if it is not cached or it changed since it was cached.
+SCRIPT *load_script(char *path, struct stat *info){
+    //Caches scripts by their full path, so relative paths from different directories don't collide.
+    char *key = realpath(path, NULL);
+    if(key == NULL){
+        perror("Error -- realpath()");
+        return NULL;
+    }
+    for(SCRIPT **s = &script_cache; *s != NULL; s = &(*s)->next){
+        SCRIPT *script = *s;
+        if(strcmp(script->path, key) != 0)
+            continue;
+        //Returns the cached script if the file was not modified.
+        if(script->size == info->st_size && script->mtime.tv_sec == info->st_mtim.tv_sec
+           && script->mtime.tv_nsec == info->st_mtim.tv_nsec){
+            free(key);
+            return script;
+        }
+        //Removes the outdated script from the cache, freeing it once nothing is running it.
+        *s = script->next;
+        script->stale = true;
+        if(script->users == 0)
+            free_script(script);
+        break;
+    }
+    //Reads the whole file.
+    int fd = open(key, O_RDONLY);
+    if(fd == -1){
+        perror("Error -- open()");
+        free(key);
+        return NULL;
+    }
+    char *text = malloc(info->st_size + 1);
+    ssize_t length = 0, n;
+    while(length < info->st_size && (n = read(fd, text + length, info->st_size - length)) > 0)
+        length += n;
+    text[length] = '\0';
+    close(fd);
+    //Tokenizes and parses the file once, keeping only the parse tree.
+    TOKENS tokens = {0};
+    SCRIPT *script = calloc(1, sizeof(SCRIPT));
+    lex_line(text, &tokens);
+    parse_tokens(&tokens, script);
+    free_tokens(&tokens);
+    free(text);
+    //Adds the script to the cache.
+    script->path = key;
+    script->mtime = info->st_mtim;
+    script->size = info->st_size;
+    script->next = script_cache;
+    script_cache = script;
+    return script;
+}
+
+//Executes a script one statement at a time, read through a large buffer, so its memory is bounded by its longest statement rather than its size.
+int stream_script(char *path){
+    FILE *f = fopen(path, "re");
+    if(f == NULL){
+        perror("Error -- fopen()");
+        set_exitcode(1 << 8);
+        return 1;
+    }
+    setvbuf(f, NULL, _IOFBF, SCRIPT_BUFFER_SIZE);
+    posix_fadvise(fileno(f), 0, 0, POSIX_FADV_SEQUENTIAL);
+    READER reader = {.input = f};
+    SCRIPT script = {0};
+    //Stops at the end of the file or at an 'exit' command.
+    int status = 1;
+    while(status != 0 && read_statement(&reader)){
+        parse_tokens(&reader.tokens, &script);
+        status = execute_script(&script);
+        reset_arena(&script.arena);
+    }
+    free_arena(&script.arena);
+    free_reader(&reader);
+    fclose(f);
+    return 1;
+}
+
+//Frees a script that was cached by 'source'.
+void free_script(SCRIPT *script){
+    free_arena(&script->arena);
+    free(script->path);
+    free(script);
+}
+
+//Executes a pipeline as a job, forking (or spawning) one process per stage.
+int execute_pipe(PIPELINE *pipeline){
+    int n = pipeline->count;
+    int pipes[2 * n];
+    //Creating all the pipes - stage i writes to pipe i and reads from pipe i-1.
+    //They are closed on exec, so spawned stages only keep the ends they dup.
+    for(int i=0;i<n-1;i++){
+        if(pipe2(pipes + 2 * i, O_CLOEXEC) < 0){
+            perror("Error -- pipe()");
+            //Closes the pipes created so far.
+            for(int j=0;j<2*i;j++)
+                close(pipes[j]);
+            return 1;
+        }
+    }
+    //Creating a process for every stage, all in the process group of the first one.
+    JOB *job = new_job(pipeline, NULL, n);
+    bool spawn = use_spawn();
+    for(int i=0;i<n;i++){
+        int in = i > 0 ? pipes[2 * (i - 1)] : -1;
+        int out = i < n - 1 ? pipes[2 * i + 1] : -1;
+        //Spawns external commands, forking only for internal commands.
+        if(spawn && is_external(&pipeline->commands[i])){
+            add_job_process(job, spawn_command(&pipeline->commands[i], NULL, in, out, job_pgid(job)));
+            continue;
+        }
+        pid_t pid = fork_process(job_pgid(job));
+        if(pid == -1){
+            perror("Error -- fork()");
+        } else if(pid == 0){
+            //Sets stdin to the reading end of the previous pipe.
+            if(in != -1)
+                dup2(in, STDIN_FILENO);
+            //Sets stdout to the writing end of the next pipe.
+            if(out != -1)
+                dup2(out, STDOUT_FILENO);
+            //Closes every pipe, so each reader sees the end of its input when its writer exits.
+            for(int j=0;j<2*(n-1);j++)
+                close(pipes[j]);
+            exec_command(&pipeline->commands[i]);
+        }
+        add_job_process(job, pid);
+    }
+    //Closes the pipes in the shell.
+    for(int j=0;j<2*(n-1);j++)
+        close(pipes[j]);
+    //Waits for the job, unless it runs in the background.
+    run_job(job, pipeline->background);
+    return 1;
+}
+
+//Applies the redirections of a command to the current process, returning 0 if one failed.
+int apply_redirects(COMMAND *command){
+    //Applies the redirections from left to right.
+    for(int r=0;r<command->redirect_count;r++){
+        REDIRECT *redirect = &command->redirects[r];
+        //Expands the file name, the 'HERE string' or the body of a 'HERE document'.
+        char **files = build_args(redirect->words, redirect->word_count, redirect->args, &redirect->expansion);
+        int fd;
+        //Opening an appropriate file depending on the operator (with open() rather than fopen(), which would allocate a FILE).
+        if (redirect->type == OUT_REDIRECT) {
+            fd = open(files[0], O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        } else if (redirect->type == APPEND_REDIRECT){
+            fd = open(files[0], O_WRONLY | O_CREAT | O_APPEND, 0666);
+        } else if(redirect->type == IN_REDIRECT){
+            fd = open(files[0], O_RDONLY);
+        } else {
+            fd = here_input(redirect, files);
+            if(fd == -1)
+                return 0;
+            dup2(fd, STDIN_FILENO);
+            close(fd);
+            continue;
+        }
+        if(fd == -1){
+            perror("Error -- open()");
+            return 0;
+        }
+        //Setting stdout (for '>' and '>>') or stdin (for '<') to the file.
+        if(redirect->type == OUT_REDIRECT || redirect->type == APPEND_REDIRECT)
+            dup2(fd, STDOUT_FILENO);
+        else
+            dup2(fd, STDIN_FILENO);
+        //Closing the file.
+        close(fd);
+    }
+    return 1;
+}
+
+//Opens the files of a command's redirections for a process the shell launches, replacing its stdin ('fds[0]') or stdout ('fds[1]').
+//The descriptors are closed on exec and left in 'opened' for the caller to close. Returns 0 (after closing them) if one could not be opened.
+int open_redirects(COMMAND *command, int *fds, int *opened){
+    for(int r=0;r<command->redirect_count;r++){
+        REDIRECT *redirect = &command->redirects[r];
+        char **files = build_args(redirect->words, redirect->word_count, redirect->args, &redirect->expansion);
+        int fd, target = redirect->type == OUT_REDIRECT || redirect->type == APPEND_REDIRECT;
+        if(redirect->type == OUT_REDIRECT){
+            fd = open(files[0], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        } else if(redirect->type == APPEND_REDIRECT){
+            fd = open(files[0], O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+        } else if(redirect->type == IN_REDIRECT){
+            fd = open(files[0], O_RDONLY | O_CLOEXEC);
+        } else {
+            fd = here_input(redirect, files);
+        }
+        if(fd == -1){
+            if(redirect->type != HERE_STRING && redirect->type != HERE_DOCUMENT)
+                perror("Error -- open()");
+            for(int i=0;i<2;i++){
+                if(opened[i] != -1)
+                    close(opened[i]);
+            }
+            return 0;
+        }
+        if(opened[target] != -1)
+            close(opened[target]);
+        opened[target] = fds[target] = fd;
+    }
+    return 1;
+}
+
+//Returns a descriptor reading the input of a 'HERE string' (its words on one line) or a 'HERE document' (its body).
+int here_input(REDIRECT *redirect, char **words){
+    if(redirect->type == HERE_DOCUMENT)
+        return here_document(words[0], strlen(words[0]));
+    //Joins the words of the 'HERE string' with spaces.
+    size_t length = 0;
+    for(int i=0;words[i]!=NULL;i++)
+        length += strlen(words[i]) + 1;
+    char *text = malloc(length + 1), *end = text;
+    for(int i=0;words[i]!=NULL;i++)
+        end += sprintf(end, "%s%s", words[i], words[i+1] == NULL ? "\n" : " ");
+    int fd = here_document(text, length);
+    free(text);
+    return fd;
+}
+
+//Returns a descriptor reading 'text' without touching the filesystem - a pipe if the text fits in its buffer, otherwise a memfd.
+//The descriptor is closed on exec, so only a dup of it is inherited.
+int here_document(char *text, size_t length){
+    int fds[2], fd;
+    if(pipe2(fds, O_CLOEXEC) == 0){
+        //Writes the whole text to the pipe, which cannot block as it fits in the pipe's buffer.
+        if(length <= fcntl(fds[1], F_GETPIPE_SZ) && write_all(fds[1], text, length) == 0){
+            close(fds[1]);
+            return fds[0];
+        }
+        close(fds[0]);
+        close(fds[1]);
+    }
+    //Uses an anonymous memory file for larger texts.
+    if((fd = memfd_create("here-document", MFD_CLOEXEC)) == -1 || write_all(fd, text, length) == -1){
+        perror("Error -- memfd_create()");
+        if(fd != -1)
+            close(fd);
+        return -1;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+//Writes all of a buffer to a descriptor, returning -1 if it fails.
+int write_all(int fd, char *buffer, size_t length){
+    while(length > 0){
+        ssize_t n = write(fd, buffer, length);
+        if(n == -1 && errno == EINTR)
+            continue;
+        if(n == -1)
+            return -1;
+        buffer += n;
+        length -= n;
+    }
+    return 0;
+}
+
+//Reads exactly 'length' bytes, returning -1 if the input ends (or fails) first.
+int read_all(int fd, char *buffer, size_t length){
+    while(length > 0){
+        ssize_t n = read(fd, buffer, length);
+        if(n == -1 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return -1;
+        buffer += n;
+        length -= n;
+    }
+    return 0;
+}
+
+//Executes an internal command (or an assignment) with its redirections in the shell process.
+int redirect_in_process(COMMAND *command){
+    int status = 1;
+    //Saves stdin and stdout (closed on exec, so commands launched by the internal command don't inherit the copies).
+    fflush(stdout);
+    int saved_in = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10);
+    int saved_out = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+    if(apply_redirects(command))
+        status = execute_command(command);
+    else
+        set_exitcode(1 << 8);
+    //Restores stdin and stdout.
+    fflush(stdout);
+    if(saved_in != -1){
+        dup2(saved_in, STDIN_FILENO);
+        close(saved_in);
+    }
+    if(saved_out != -1){
+        dup2(saved_out, STDOUT_FILENO);
+        close(saved_out);
+    }
+    return status;
+}
+
+//Executes a command with its redirections in a forked process, which exits when it is done.
+//Forked children leave with _exit(), as exit() would move the offset of the shell's input (shared with the child) back to what stdio read of it.
+void exec_command(COMMAND *command){
+    if(apply_redirects(command) == 0)
+        _exit(1);
+    //Replaces the process with external commands, rather than forking again in launch().
+    if(is_external(command))
+        exec_external(build_args(command->words, command->word_count, command->args, &command->expansion));
+    //Exits with the status of the internal command (or of the command it launched).
+    set_exitcode(0);
+    execute_command(command);
+    fflush(stdout);
+    _exit(exit_status());
+}
+
+//Reads the next statement of the input into the reader's buffer and tokenizes it, reading more lines while it ends in '\' or inside a 'HERE document'.
+//The buffers are reused for every statement, so they are only reallocated for a statement longer than every one before it.
+//Returns false at the end of the input, if nothing was read.
+bool read_statement(READER *reader){
+    ssize_t n;
+    reader->length = 0;
+    reader->tokens.open_delimiter = NULL;
+    while((n = reader->edit ? edit_line(reader) : getline(&reader->line, &reader->line_capacity, reader->input)) != -1){
+        //Replaces the history references of the line, displaying the line they give (an error discards the statement).
+        if(n > 0 && reader->history && memchr(reader->line, '!', n) != NULL){
+            bool error;
+            char *expanded = expand_history(reader->line, &error);
+            if(error)
+                n = 0;
+            if(expanded != NULL){
+                free(reader->line);
+                reader->line = expanded;
+                n = strlen(expanded);
+                reader->line_capacity = n + 1;
+                printf("%s", expanded);
+            }
+        }
+        //Discards the statement if the line was cancelled (with Ctrl-C).
+        if(n == 0){
+            reader->length = 0;
+            reader->tokens.open_delimiter = NULL;
+            lex_line("", &reader->tokens);
+            return true;
+        }
+        //Appends the line to the statement.
+        if(reader->length + n + 1 > reader->capacity){
+            reader->capacity = 2 * (reader->length + n + 1);
+            reader->text = realloc(reader->text, reader->capacity);
+        }
+        memcpy(reader->text + reader->length, reader->line, n + 1);
+        reader->length += n;
+        //Skips tokenizing the lines of a 'HERE document' until its delimiter, so long bodies are not tokenized once per line.
+        char *delimiter = reader->tokens.open_delimiter;
+        if(delimiter != NULL){
+            size_t length = strlen(delimiter);
+            if(strncmp(reader->line, delimiter, length) != 0 || (strcmp(reader->line + length, "\n") != 0 && reader->line[length] != '\0'))
+                continue;
+        }
+        lex_line(reader->text, &reader->tokens);
+        if(!reader->tokens.incomplete)
+            return true;
+    }
+    //Executes what was read of an incomplete statement at the end of the input.
+    if(reader->length == 0)
+        return false;
+    lex_line(reader->text, &reader->tokens);
+    return true;
+}
+
+//Frees the buffers of a reader.
+void free_reader(READER *reader){
+    free(reader->line);
+    free(reader->text);
+    free_tokens(&reader->tokens);
+    reader->line = reader->text = NULL;
+    reader->line_capacity = reader->length = reader->capacity = 0;
+}
+
+/* --------------------- COMMANDS --------------------- */
+
+//The 'exit' internal command - Tells shell to exit.
+int exit_comm(char **args){
+    return 0;
+}
+
+//The 'print' internal command - Displays variable values and strings.
+int print_comm(char **args){
+    //Executes if no arguments were inputted after 'print'.
+    if(args[1] == NULL){
+        fprintf(stderr,"Error -- No arguments inputted after the command \'print\'.\n");
+        set_exitcode(1 << 8);
+    } else {
+        //Prints the arguments - variables were already replaced unless they were in quotes.
+        for(int index = 1; args[index] != NULL; index++){
+            printf("%s%s", args[index], args[index+1] == NULL ? "\n" : " ");
+        }
+        set_exitcode(0);
+    }
+    return 1;
+}
+
+//The 'chdir' internal command - Changes directories.
+int chdir_comm(char **args){
+    //Executes if no arguments were inputted after 'chdir'.
+    if (args[1] == NULL){
+        fprintf(stderr,"Error -- No arguments inputted after the command \'chdir\'.\n");
+        set_exitcode(1 << 8);
+    } else {
+        //Changes the directory using the 'chdir()' function.
+        if (chdir(args[1]) == 0){
+            printf("Directory has been changed successfully.\n");
+            set_cwd(); //Updates the environment variable 'CWD'.
+            set_exitcode(0);
+        } else {
+            perror("Error -- chdir()");
+            set_exitcode(1 << 8);
+        }
+    }
+    return 1;
+}
+
+//The 'all' internal command - Displays all variables and their values.
+int all_comm(char **args){
+    //Displays the environment variable and it's value.
+    for(int i=0;i<VAR_SIZE;i++){
+        //Skips variables that were deleted.
+        if(variables[i].name == NULL)
+            continue;
+        printf("%s=%s\n", variables[i].name, variables[i].value);
+    }
+    set_exitcode(0);
+    return 1;
+}
+
+//The 'unset' internal command - Deletes variables.
+int unset_comm(char **args){
+    //Executes if no arguments were inputted after 'unset'.
+    int status = 0;
+    if (args[1] == NULL){
+        fprintf(stderr,"Error -- No arguments inputted after the command \'unset\'.\n");
+        status = 1 << 8;
+    } else {
+        for(int i=1;args[i]!=NULL;i++){
+            if(delete_var(args[i]) == 0){
+                fprintf(stderr,"Error -- The variable \'%s\' does not exist.\n", args[i]);
+                status = 1 << 8;
+            }
+        }
+    }
+    set_exitcode(status);
+    return 1;
+}
+
+//The 'export' internal command - Passes variables to the programs the shell launches ('export NAME' or 'export NAME=value'),
+//stops passing them ('export -n NAME'), or displays the ones it passes.
+int export_comm(char **args){
+    int status = 0;
+    if(args[1] == NULL){
+        for(int i=0;i<ENV_COUNT;i++)
+            printf("export %s\n", envp[i]);
+        set_exitcode(status);
+        return 1;
+    }
+    bool remove = strcmp(args[1], "-n") == 0;
+    for(int i = remove ? 2 : 1;args[i]!=NULL;i++){
+        int length = assignment_name_length(args[i]);
+        if(length == 0 && name_length_of(args[i]) != (int)strlen(args[i])){
+            fprintf(stderr,"Error -- \'%s\' is not a valid variable name.\n", args[i]);
+            status = 1 << 8;
+            continue;
+        }
+        //Sets the variable first if a value was given, ending the name in place.
+        if(length > 0){
+            args[i][length] = '\0';
+            modify_var(args[i], args[i] + length + 1);
+        }
+        int var = find_var(args[i]);
+        if(!remove)
+            export_var(args[i]);
+        else if(var != -1 && variables[var].env_slot != -1)
+            unexport_var(var);
+        if(length > 0)
+            args[i][length] = '=';
+    }
+    set_exitcode(status);
+    return 1;
+}
+
+//The 'source' internal command - Opens a text file, reads it and uses the input to execute commands.
+int source_comm(char **args){
+    //Executes if no arguments were inputted after 'source'.
+    if (args[1] == NULL){
+        fprintf(stderr,"Error -- No arguments inputted after the command \'source\'.\n");
+        set_exitcode(1 << 8);
+    } else {
+        //Stats the file once, for choosing how to run it and for checking its cached parse tree.
+        struct stat info;
+        if(stat(args[1], &info) == -1){
+            perror("Error -- stat()");
+            set_exitcode(1 << 8);
+            return 1;
+        }
+        //An empty file leaves a status of 0; otherwise the status is the one of its last command.
+        set_exitcode(0);
+        //Executes large scripts while reading them, instead of parsing and caching them whole.
+        if(info.st_size > SCRIPT_CACHE_LIMIT)
+            return stream_script(args[1]);
+        //Parses the file, or reuses its parse tree if it was sourced before and did not change.
+        SCRIPT *script = load_script(args[1], &info);
+        if(script == NULL){
+            set_exitcode(1 << 8);
+            return 1;
+        }
+        //Executes every command of the file.
+        script->users++;
+        execute_script(script);
+        script->users--;
+        //Frees the script if the file was changed (and re-parsed) while it was running.
+        if(script->stale && script->users == 0)
+            free_script(script);
+    }
+    return 1;
+}
+
+//The 'hash' internal command - Displays the hashed commands, forgets them ('-r') or hashes new ones.
+int hash_comm(char **args){
+    int status = 0;
+    //Displays the hashed commands and the number of times each one was used.
+    if(args[1] == NULL){
+        if(HASH_COUNT == 0)
+            printf("The command hash is empty.\n");
+        else
+            printf("hits\tcommand\n");
+        for(int i=0;i<HASH_SIZE;i++){
+            if(command_hash[i].name != NULL)
+                printf("%4d\t%s\n", command_hash[i].hits, command_hash[i].path);
+        }
+    } else if(strcmp(args[1], "-r") == 0){
+        clear_command_hash();
+    } else {
+        //Hashes the commands now, without running them.
+        for(int i=1;args[i]!=NULL;i++){
+            if(find_command(args[i]) == NULL){
+                fprintf(stderr,"Error -- %s: command not found.\n", args[i]);
+                status = 1 << 8;
+            }
+        }
+    }
+    set_exitcode(status);
+    return 1;
+}
+
+//The 'jobs' internal command - Displays the background jobs, forgetting the ones that finished.
+int jobs_comm(char **args){
+    reap_children();
+    for(int i=0;i<JOB_SIZE;i++){
+        JOB *job = job_table[i];
+        if(!job->used || !job->background)
+            continue;
+        printf("[%d]  %-10s\t%s\n", job->id, job_state(job), job_text(job));
+        if(job->running == 0)
+            free_job(job);
+    }
+    set_exitcode(0);
+    return 1;
+}
+
+//The 'fg' internal command - Continues a background job ('%n', or the newest one) in the foreground.
+int fg_comm(char **args){
+    reap_children();
+    JOB *job = find_job(args[1]);
+    if(job == NULL){
+        fprintf(stderr,"Error -- No such job.\n");
+        set_exitcode(1 << 8);
+        return 1;
+    }
+    printf("%s\n", job_text(job));
+    job->background = false;
+    if(job->stopped)
+        continue_job(job);
+    set_exitcode(wait_job(job, true));
+    return 1;
+}
+
+//The 'bg' internal command - Continues a stopped job ('%n', or the newest one) in the background.
+int bg_comm(char **args){
+    reap_children();
+    JOB *job = find_job(args[1]);
+    if(job == NULL){
+        fprintf(stderr,"Error -- No such job.\n");
+        set_exitcode(1 << 8);
+    } else if(!job->stopped){
+        fprintf(stderr,"Error -- Job %d is already running.\n", job->id);
+        set_exitcode(1 << 8);
+    } else {
+        continue_job(job);
+        printf("[%d] %s &\n", job->id, job_text(job));
+        set_exitcode(0);
+    }
+    return 1;
+}
+
+//The 'wait' internal command - Waits for the given jobs ('%n') or processes, or for every background job.
+int wait_comm(char **args){
+    int status = 0;
+    reap_children();
+    if(args[1] == NULL){
+        for(int i=0;i<JOB_SIZE;i++){
+            if(job_table[i]->used && job_table[i]->background)
+                status = wait_job(job_table[i], false);
+        }
+    }
+    for(int i=1;args[i]!=NULL;i++){
+        JOB *job = args[i][0] == '%' ? find_job(args[i]) : find_pid_job(atoi(args[i]));
+        if(job == NULL){
+            fprintf(stderr,"Error -- \'%s\' is not a job of this shell.\n", args[i]);
+            status = 127 << 8;
+            continue;
+        }
+        status = wait_job(job, false);
+    }
+    set_exitcode(status);
+    return 1;
+}
+
+//The 'break' internal command - Leaves the loop it runs in (or the n-th enclosing one with 'break n').
+int break_comm(char **args){
+    int count = args[1] == NULL ? 1 : atoi(args[1]);
+    if(LOOP_DEPTH == 0 || count < 1){
+        fprintf(stderr,"Error -- \'%s\' can only leave 1 to %d loops here.\n", args[0], LOOP_DEPTH);
+        set_exitcode(1 << 8);
+        return 1;
+    }
+    LOOP_EXITS = count < LOOP_DEPTH ? count : LOOP_DEPTH;
+    LOOP_CONTINUE = false;
+    set_exitcode(0);
+    return 1;
+}
+
+//The 'continue' internal command - Goes on to the next iteration of the loop it runs in (or of the n-th enclosing one with 'continue n').
+int continue_comm(char **args){
+    break_comm(args);
+    LOOP_CONTINUE = LOOP_EXITS != 0;
+    return 1;
+}
+
+//The 'parallel' internal command - Runs a command for every item (the words after ':::', or the lines of stdin), at most N ('-j N') at a time.
+//'{}' in the command is replaced by the item, which is added as the last word otherwise. Without a command, every item is a command line.
+//The output of each job is printed at once when it finishes, and its status is kept in 'PARALLEL_<n>' (numbered in input order).
+int parallel_comm(char **args){
+    long limit = sysconf(_SC_NPROCESSORS_ONLN);
+    int first = 1;
+    if(args[1] != NULL && strcmp(args[1], "-j") == 0){
+        if(args[2] == NULL || (limit = atol(args[2])) < 1){
+            fprintf(stderr,"Error -- \'-j\' needs a positive number of jobs.\n");
+            set_exitcode(1 << 8);
+            return 1;
+        }
+        first = 3;
+    }
+    //Splits the command from the items.
+    int separator = first, item_count = 0;
+    while(args[separator] != NULL && strcmp(args[separator], ":::") != 0)
+        separator++;
+    char **items = NULL, *line = NULL;
+    if(args[separator] != NULL){
+        items = &args[separator + 1];
+        while(items[item_count] != NULL)
+            item_count++;
+    } else {
+        //Reads the items from stdin, bypassing its buffer so none of the shell's own input is used.
+        FILE *input = fdopen(dup(STDIN_FILENO), "r");
+        size_t size = 0;
+        ssize_t length;
+        while(input != NULL && (length = getline(&line, &size, input)) != -1){
+            if(line[length - 1] == '\n')
+                line[--length] = '\0';
+            if(length == 0)
+                continue;
+            items = realloc(items, (item_count + 1) * sizeof(char *));
+            items[item_count++] = strdup(line);
+        }
+        free(line);
+        if(input != NULL)
+            fclose(input);
+    }
+    //Jobs read nothing, so they don't compete for the terminal or the items.
+    int null = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if(limit > item_count)
+        limit = item_count;
+    //The running jobs, the descriptors buffering their stdout and stderr, and their item numbers.
+    JOB *jobs[limit > 0 ? limit : 1];
+    int outputs[limit > 0 ? limit : 1], errors[limit > 0 ? limit : 1], numbers[limit > 0 ? limit : 1];
+    int next = 0, active = 0, exitcode = 0;
+    bool stopped = false;
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGCHLD);
+    while((next < item_count && !stopped) || active > 0){
+        //Starts jobs until the pool is full.
+        while(next < item_count && active < limit && !stopped){
+            outputs[active] = memfd_create("parallel-output", MFD_CLOEXEC);
+            errors[active] = memfd_create("parallel-errors", MFD_CLOEXEC);
+            //Stops starting jobs if their output cannot be buffered (a pipe could fill up while no one reads it), finishing the running ones.
+            if(outputs[active] == -1 || errors[active] == -1){
+                perror("Error -- memfd_create()");
+                if(outputs[active] != -1)
+                    close(outputs[active]);
+                if(errors[active] != -1)
+                    close(errors[active]);
+                stopped = true;
+                break;
+            }
+            numbers[active] = next + 1;
+            jobs[active] = parallel_job(&args[first], separator - first, items[next++], null, outputs[active], errors[active]);
+            active++;
+        }
+        if(active == 0)
+            break;
+        //Waits for a job to finish.
+        int done = -1;
+        sigprocmask(SIG_BLOCK, &block, &old);
+        reap_children();
+        while(done == -1){
+            for(int i=0;i<active && done == -1;i++){
+                if(jobs[i]->running == 0)
+                    done = i;
+            }
+            if(done == -1){
+                sigsuspend(&old);
+                reap_children();
+            }
+        }
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        //Prints its output and records its status.
+        fflush(stdout);
+        copy_output(outputs[done], STDOUT_FILENO);
+        copy_output(errors[done], STDERR_FILENO);
+        int status = job_status(jobs[done]);
+        char name[32], value[32];
+        sprintf(name, "PARALLEL_%d", numbers[done]);
+        sprintf(value, "%d", status);
+        modify_var(name, value);
+        if(status != 0)
+            exitcode = status;
+        free_job(jobs[done]);
+        //Moves the last running job into the free slot.
+        active--;
+        jobs[done] = jobs[active];
+        outputs[done] = outputs[active];
+        errors[done] = errors[active];
+        numbers[done] = numbers[active];
+    }
+    if(null != -1)
+        close(null);
+    //Forgets the statuses of a previous, longer run (only the jobs that were started are counted).
+    char *previous = return_var_value("PARALLEL_COUNT"), name[32], value[32];
+    //Reads the old count first, as deleting variables may move their values.
+    int previous_count = previous != NULL ? atoi(previous) : 0;
+    for(int i=next+1;i<=previous_count;i++){
+        sprintf(name, "PARALLEL_%d", i);
+        delete_var(name);
+    }
+    sprintf(value, "%d", next);
+    modify_var("PARALLEL_COUNT", value);
+    //Sets the exit code to the status of the last job that failed, or to an error if not every job could be started.
+    set_exitcode(stopped ? 1 << 8 : exitcode);
+    if(args[separator] == NULL){
+        for(int i=0;i<item_count;i++)
+            free(items[i]);
+        free(items);
+    }
+    return 1;
+}
+
+//Starts a job of the 'parallel' command for an item, with its stdin, stdout and stderr set to 'in', 'out' and 'err'.
+JOB *parallel_job(char **template, int count, char *item, int in, int out, int err){
+    JOB *job = new_job(NULL, NULL, 1);
+    pid_t pid;
+    //Runs a command line in a forked shell, exiting with the status of its last command.
+    if(count == 0){
+        TOKENS tokens = {0};
+        SCRIPT script = {0};
+        lex_line(item, &tokens);
+        parse_tokens(&tokens, &script);
+        if((pid = fork_process(-1)) == 0){
+            dup2(in, STDIN_FILENO);
+            dup2(out, STDOUT_FILENO);
+            dup2(err, STDERR_FILENO);
+            set_exitcode(0);
+            execute_script(&script);
+            fflush(stdout);
+            _exit(exit_status());
+        }
+        if(pid == -1)
+            perror("Error -- fork()");
+        free_tokens(&tokens);
+        free_arena(&script.arena);
+    } else {
+        //Builds the arguments, replacing every '{}' with the item (or adding the item after them).
+        char *words[count + 2];
+        bool replaced = false;
+        for(int i=0;i<count;i++){
+            char *at = strstr(template[i], "{}");
+            replaced |= at != NULL;
+            size_t length = strlen(template[i]) + 1;
+            for(; at != NULL; at = strstr(at + 2, "{}"))
+                length += strlen(item);
+            words[i] = malloc(length);
+            char *to = words[i], *from = template[i];
+            for(at = strstr(from, "{}"); at != NULL; from = at + 2, at = strstr(from, "{}"))
+                to += sprintf(to, "%.*s%s", (int)(at - from), from, item);
+            strcpy(to, from);
+        }
+        words[count] = replaced ? NULL : strdup(item);
+        words[count + 1] = NULL;
+        //Spawns external commands like launch(), forking for internal commands.
+        int builtin = find_builtin(words[0]);
+        if(builtin == -1 && use_spawn()){
+            //The spawned process inherits stderr, so the shell's stderr points to the buffer while it starts.
+            int saved_err = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 10);
+            dup2(err, STDERR_FILENO);
+            pid = spawn_command(NULL, words, in, out, -1);
+            dup2(saved_err, STDERR_FILENO);
+            close(saved_err);
+        } else if((pid = fork_process(-1)) == 0){
+            dup2(in, STDIN_FILENO);
+            dup2(out, STDOUT_FILENO);
+            dup2(err, STDERR_FILENO);
+            if(builtin == -1)
+                exec_external(words);
+            set_exitcode(0);
+            builtins[builtin].function(words);
+            fflush(stdout);
+            _exit(exit_status());
+        } else if(pid == -1 && builtin != -1){
+            perror("Error -- fork()");
+        }
+        for(int i=0;words[i]!=NULL;i++)
+            free(words[i]);
+    }
+    add_job_process(job, pid);
+    return job;
+}
+
+//Copies everything written to a buffer descriptor to 'to', then closes the buffer.
+void copy_output(int from, int to){
+    if(from == -1)
+        return;
+    lseek(from, 0, SEEK_SET);
+    copy_fd(from, to);
+    close(from);
+}
+
+//Executes external commands, searching for a program and launching a process.
+int launch(char **args){
+    JOB *job = new_job(NULL, args, 1);
+    pid_t pid;
+    //Spawning the process.
+    if(use_spawn()){
+        pid = spawn_command(NULL, args, -1, -1, job_pgid(job));
+    //Creating a process.
+    } else if((pid = fork_process(job_pgid(job))) == -1){
+        perror("Error - fork()");
+    } else if(pid == 0){ //If PID is the child process.
+        exec_external(args);
+    }
+    //Waits for the process and sets the exit code.
+    add_job_process(job, pid);
+    run_job(job, false);
+    return 1;
+}
+
+//Returns whether a command runs an external program.
+bool is_external(COMMAND *command){
+    if(command->type != EXTERNAL)
+        return false;
+    //Names that came from a variable may still be internal commands, and so may functions defined after the command was parsed.
+    char *name[2];
+    return find_builtin(command->words[0].expand ? build_args(command->words, 1, name, &command->expansion)[0] : command->words[0].text) == -1;
+}
+
+//Returns whether external commands are launched with posix_spawn (the default) rather than fork (LAUNCHER=fork).
+//With LAUNCHER=zygote, spawn_command() hands them to the zygote.
+bool use_spawn(){
+    char *launcher = return_var_value("LAUNCHER");
+    return launcher == NULL || strcmp(launcher, "fork") != 0;
+}
+
+//Spawns an external command without copying the shell's address space, returning its PID (or -1, or REDIRECT_FAILED if a redirection failed).
+//Its stdin and stdout are set to 'in' and 'out' (unless they are -1), then the command's redirections are applied.
+//It joins the process group 'pgid' (0 for a new group) unless it is -1.
+pid_t spawn_command(COMMAND *command, char **args, int in, int out, pid_t pgid){
+    if(use_zygote())
+        return zygote_command(command, args, in, out, pgid);
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    short flags = 0;
+    if(pgid != -1){
+        posix_spawnattr_setpgroup(&attributes, pgid);
+        flags |= POSIX_SPAWN_SETPGROUP;
+    }
+    //Restores the signals the shell ignores for job control.
+    if(JOB_CONTROL){
+        sigset_t defaults;
+        sigemptyset(&defaults);
+        for(int i=0;i<sizeof(JOB_SIGNALS)/sizeof(int);i++)
+            sigaddset(&defaults, JOB_SIGNALS[i]);
+        posix_spawnattr_setsigdefault(&attributes, &defaults);
+        flags |= POSIX_SPAWN_SETSIGDEF;
+    }
+    posix_spawnattr_setflags(&attributes, flags);
+    //Opens the files of the redirections in the shell, so a failure to open one is not taken for a missing program.
+    int fds[] = {in, out}, opened[] = {-1, -1};
+    if(command != NULL){
+        if(open_redirects(command, fds, opened) == 0){
+            posix_spawn_file_actions_destroy(&actions);
+            posix_spawnattr_destroy(&attributes);
+            return REDIRECT_FAILED;
+        }
+        args = build_args(command->words, command->word_count, command->args, &command->expansion);
+    }
+    if(fds[0] != -1)
+        posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    if(fds[1] != -1)
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    //Launches the process from its hashed path, flushing stdout first so the shell's output stays in order.
+    pid_t pid;
+    int error = ENOENT;
+    char *path = find_command(args[0]);
+    if(path != NULL){
+        fflush(stdout);
+        PROCESS_COUNT++;
+        error = posix_spawn(&pid, path, &actions, &attributes, args, envp);
+        //Searches PATH again if the hashed program was moved or deleted.
+        if(error == ENOENT && strchr(args[0], '/') == NULL){
+            clear_command_hash();
+            if((path = find_command(args[0])) != NULL)
+                error = posix_spawn(&pid, path, &actions, &attributes, args, envp);
+        }
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    for(int i=0;i<2;i++){
+        if(opened[i] != -1)
+            close(opened[i]);
+    }
+    if(path == NULL){
+        fprintf(stderr, "Error - %s: command not found.\n", args[0]);
+        return -1;
+    } else if(error != 0){
+        fprintf(stderr, "Error - posix_spawn(): %s\n", strerror(error));
+        return -1;
+    }
+    return pid;
+}
+
+//Replaces the current (child) process with an external program.
+void exec_external(char **args){
+    //Signal handling for processes.
+    if(signal(SIGINT, signals) == SIG_ERR)
+        perror("Error - signal()");
+    //Launches the process from its hashed path, with the exported variables as its environment.
+    char *path = find_command(args[0]);
+    if (path == NULL) {
+        fprintf(stderr, "Error - %s: command not found.\n", args[0]);
+    } else if (execve(path, args, envp) < 0) {
+        perror("Error - execve()");
+    }
+    //Exits the child if the program could not be launched, instead of it carrying on as a second shell.
+    _exit(127);
+}
+
+//Forks the shell, counting the process and flushing stdout first so the child does not print the shell's output again.
+//The child joins the process group 'pgid' (0 for a new group) unless it is -1.
+pid_t fork_process(pid_t pgid){
+    fflush(stdout);
+    PROCESS_COUNT++;
+    pid_t pid = fork();
+    if(pid == 0){
+        if(pgid != -1)
+            setpgid(0, pgid);
+        //Restores the signals the shell ignores for job control, and forgets the shell's jobs.
+        if(JOB_CONTROL){
+            for(int i=0;i<sizeof(JOB_SIGNALS)/sizeof(int);i++)
+                signal(JOB_SIGNALS[i], SIG_DFL);
+        }
+        forget_jobs();
+    } else if(pid > 0 && pgid != -1){
+        //Also sets the group in the shell, so it exists before the terminal is given to it or the next stage joins it.
+        setpgid(pid, pgid == 0 ? pid : pgid);
+    }
+    return pid;
+}
+
+/* ------------------ FAST COMMANDS ------------------- */
+
+//The 'true' internal command - Exits with 0, without launching /bin/true.
+int true_comm(char **args){
+    set_exitcode(0);
+    return 1;
+}
+
+//The 'false' internal command - Exits with 1.
+int false_comm(char **args){
+    set_exitcode(1 << 8);
+    return 1;
+}
+
+//The 'echo' internal command - Displays its arguments like /bin/echo ('-n' leaves out the newline, '-e' interprets backslash escapes).
+int echo_comm(char **args){
+    bool newline = true, escapes = false, stop = false;
+    int i = 1;
+    //Options are words made only of 'n', 'e' and 'E' after a '-', anything else is printed.
+    for(;args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0' && strspn(args[i] + 1, "neE") == strlen(args[i] + 1);i++){
+        for(char *option = args[i] + 1; *option != '\0'; option++){
+            if(*option == 'n')
+                newline = false;
+            else
+                escapes = *option == 'e';
+        }
+    }
+    for(;args[i] != NULL && !stop;i++){
+        if(!escapes)
+            fputs(args[i], stdout);
+        for(char *p = args[i]; escapes && *p != '\0' && !stop;)
+            p = *p == '\\' ? print_escape(p, true, &stop) : (putchar(*p), p + 1);
+        if(args[i+1] != NULL && !stop)
+            putchar(' ');
+    }
+    //'\c' also leaves out the newline.
+    if(newline && !stop)
+        putchar('\n');
+    set_exitcode(0);
+    return 1;
+}
+
+//Prints the backslash escape at 'p' and returns where the text after it starts - octal escapes are '\0NNN' for echo and '%b', or '\NNN' in a printf format.
+//Sets 'stop' for '\c', which ends the output.
+char *print_escape(char *p, bool echo, bool *stop){
+    char *escapes = "\\\\a\ab\bf\fn\nr\rt\tv\v\"\"\'\'", *found;
+    p++;
+    if(*p == 'c'){
+        *stop = true;
+        return p + 1;
+    }
+    //Octal and hexadecimal character codes.
+    if((echo && *p == '0') || (!echo && *p >= '0' && *p <= '7') || (*p == 'x' && isxdigit(p[1]))){
+        int base = *p == 'x' ? 16 : 8, digits = 0, code = 0;
+        if(*p == 'x' || echo)
+            p++;
+        while(digits < (base == 16 ? 2 : 3) && (base == 16 ? isxdigit(*p) : (*p >= '0' && *p <= '7'))){
+            code = code * base + (isdigit(*p) ? *p - '0' : tolower(*p) - 'a' + 10);
+            p++, digits++;
+        }
+        putchar(code);
+        return p;
+    }
+    if(*p != '\0' && (found = strchr(escapes, *p)) != NULL && (found - escapes) % 2 == 0){
+        putchar(found[1]);
+        return p + 1;
+    }
+    //Unknown escapes are printed as they are.
+    putchar('\\');
+    return p;
+}
+
+//The 'printf' internal command - Displays its arguments as the format says, reusing the format until every argument is used.
+int printf_comm(char **args){
+    if(args[1] == NULL){
+        fprintf(stderr,"Error -- No format inputted after the command \'printf\'.\n");
+        set_exitcode(1 << 8);
+        return 1;
+    }
+    char **arg = args + 2;
+    int status = 0;
+    bool stop = false;
+    do {
+        char **first = arg;
+        for(char *f = args[1]; *f != '\0' && !stop;){
+            if(*f == '\\'){
+                f = print_escape(f, false, &stop);
+                continue;
+            }
+            if(*f != '%' || f[1] == '%'){
+                putchar(*f);
+                f += *f == '%' ? 2 : 1;
+                continue;
+            }
+            //Copies the flags, width and precision of the conversion into a format for printf().
+            size_t length = strspn(f + 1, "-+ #0123456789.");
+            char conversion = f[1 + length], format[64], *value = *arg != NULL ? *arg++ : NULL;
+            if(length > 32 || conversion == '\0' || strchr("sbcdiouxXeEfFgGaA", conversion) == NULL){
+                fprintf(stderr,"Error -- printf: invalid conversion \'%.*s\'.\n", (int)length + 2, f);
+                set_exitcode(1 << 8);
+                return 1;
+            }
+            sprintf(format, "%%%.*s%s%c", (int)length, f + 1, strchr("diouxX", conversion) != NULL ? "ll" : "", conversion);
+            f += 2 + length;
+            if(conversion == 's'){
+                printf(format, value != NULL ? value : "");
+            } else if(conversion == 'b'){
+                for(char *p = value; p != NULL && *p != '\0' && !stop;)
+                    p = *p == '\\' ? print_escape(p, true, &stop) : (putchar(*p), p + 1);
+            } else if(conversion == 'c'){
+                if(value != NULL && value[0] != '\0')
+                    printf(format, value[0]);
+            } else if(strchr("di", conversion) != NULL){
+                printf(format, (long long)printf_number(value, &status));
+            } else if(strchr("ouxX", conversion) != NULL){
+                printf(format, (unsigned long long)printf_number(value, &status));
+            } else {
+                char *end = "";
+                double number = value != NULL ? strtod(value, &end) : 0;
+                if(*end != '\0'){
+                    fprintf(stderr,"Error -- printf: \'%s\' is not a number.\n", value);
+                    status = 1;
+                }
+                printf(format, number);
+            }
+        }
+        //Stops if the format used no arguments, so it is printed once.
+        if(arg == first)
+            break;
+    } while(*arg != NULL && !stop);
+    set_exitcode(status << 8);
+    return 1;
+}
+
+//Returns the integer argument of a printf conversion ('x or "x give the character code of x), setting 'status' to 1 if it is not a number.
+long long printf_number(char *value, int *status){
+    if(value == NULL)
+        return 0;
+    if(value[0] == '\'' || value[0] == '\"')
+        return (unsigned char)value[1];
+    char *end;
+    errno = 0;
+    long long number = strtoll(value, &end, 0);
+    //Large unsigned values are accepted too.
+    if(errno == ERANGE && value[0] != '-')
+        number = strtoull(value, &end, 0);
+    if(*end != '\0' || end == value){
+        fprintf(stderr,"Error -- printf: \'%s\' is not a number.\n", value);
+        *status = 1;
+    }
+    return number;
+}
+
+//The 'cat' internal command - Copies files ('-' or no files for stdin) to stdout, using sendfile() or splice() so the data is not copied through the shell.
+int cat_comm(char **args){
+    char *stdin_args[] = {args[0], "-", NULL};
+    int status = 0;
+    if(args[1] == NULL)
+        args = stdin_args;
+    for(int i=1;args[i]!=NULL;i++){
+        //Reading the terminal runs /bin/cat, which can be interrupted with CTRL-C (unlike the shell).
+        if(strcmp(args[i], "-") == 0 && JOB_CONTROL && isatty(STDIN_FILENO)){
+            launch(args);
+            return 1;
+        }
+    }
+    fflush(stdout);
+    for(int i=1;args[i]!=NULL;i++){
+        int fd = strcmp(args[i], "-") == 0 ? STDIN_FILENO : open(args[i], O_RDONLY | O_CLOEXEC);
+        if(fd == -1 || copy_fd(fd, STDOUT_FILENO) == -1){
+            fprintf(stderr,"Error -- cat: %s: %s\n", args[i], strerror(errno));
+            status = 1;
+        }
+        if(fd != -1 && fd != STDIN_FILENO)
+            close(fd);
+    }
+    set_exitcode(status << 8);
+    return 1;
+}
+
+//Copies everything from one descriptor to another inside the kernel when possible - with sendfile() from files, or splice() to or from pipes.
+//Returns -1 if reading or writing fails.
+int copy_fd(int from, int to){
+    ssize_t n;
+    do {
+        n = sendfile(to, from, NULL, 1 << 30);
+    } while(n > 0 || (n == -1 && errno == EINTR));
+    if(n == 0)
+        return 0;
+    if(errno == EINVAL || errno == ENOSYS){
+        do {
+            n = splice(from, NULL, to, NULL, 1 << 30, SPLICE_F_MOVE);
+        } while(n > 0 || (n == -1 && errno == EINTR));
+        if(n == 0)
+            return 0;
+    }
+    if(errno != EINVAL && errno != ENOSYS)
+        return -1;
+    //Copies through a buffer when neither works (e.g. from a terminal).
+    char buffer[65536];
+    while((n = read(from, buffer, sizeof(buffer))) > 0 || (n == -1 && errno == EINTR)){
+        if(n > 0 && write_all(to, buffer, n) == -1)
+            return -1;
+    }
+    return n == -1 ? -1 : 0;
+}
+
+//The 'test' and '[' internal commands - Checks a file, string or integer condition, exiting with 0 if it holds, 1 if not and 2 if it is malformed.
+int test_comm(char **args){
+    int count = 0;
+    while(args[count] != NULL)
+        count++;
+    //'[' needs a closing ']'.
+    if(strcmp(args[0], "[") == 0 && strcmp(args[--count], "]") != 0){
+        fprintf(stderr,"Error -- [: missing \']\'.\n");
+        set_exitcode(2 << 8);
+        return 1;
+    }
+    set_exitcode(evaluate_test(args + 1, count - 1) << 8);
+    return 1;
+}
+
+//Evaluates the operands of 'test', returning 0 if the condition holds, 1 if it does not and 2 if it is malformed.
+int evaluate_test(char **args, int count){
+    struct stat info;
+    if(count > 0 && strcmp(args[0], "!") == 0){
+        int result = evaluate_test(args + 1, count - 1);
+        return result == 2 ? 2 : !result;
+    }
+    //No operands are false, and one is true if it is not empty.
+    if(count <= 1)
+        return count == 0 || args[0][0] == '\0';
+    if(count == 2 && strcmp(args[0], "-n") == 0)
+        return args[1][0] == '\0';
+    if(count == 2 && strcmp(args[0], "-z") == 0)
+        return args[1][0] != '\0';
+    if(count == 2 && (strcmp(args[0], "-L") == 0 || strcmp(args[0], "-h") == 0))
+        return lstat(args[1], &info) == -1 || !S_ISLNK(info.st_mode);
+    //File tests.
+    if(count == 2 && args[0][0] == '-' && args[0][1] != '\0' && args[0][2] == '\0' && strchr("rwx", args[0][1]) != NULL)
+        return access(args[1], args[0][1] == 'r' ? R_OK : args[0][1] == 'w' ? W_OK : X_OK) != 0;
+    if(count == 2 && args[0][0] == '-' && args[0][1] != '\0' && args[0][2] == '\0' && strchr("efdsp", args[0][1]) != NULL){
+        if(stat(args[1], &info) == -1)
+            return 1;
+        switch(args[0][1]){
+            case 'f': return !S_ISREG(info.st_mode);
+            case 'd': return !S_ISDIR(info.st_mode);
+            case 's': return info.st_size == 0;
+            case 'p': return !S_ISFIFO(info.st_mode);
+            default: return 0;
+        }
+    }
+    //String and integer comparisons.
+    if(count == 3){
+        char *op = args[1];
+        if(strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+            return strcmp(args[0], args[2]) != 0;
+        if(strcmp(op, "!=") == 0)
+            return strcmp(args[0], args[2]) == 0;
+        char *names[] = {"-eq", "-ne", "-lt", "-le", "-gt", "-ge"}, *end_left, *end_right;
+        for(int i=0;i<6;i++){
+            if(strcmp(op, names[i]) != 0)
+                continue;
+            long long left = strtoll(args[0], &end_left, 10), right = strtoll(args[2], &end_right, 10);
+            if(*end_left != '\0' || *end_right != '\0' || end_left == args[0] || end_right == args[2]){
+                fprintf(stderr,"Error -- test: integer expression expected.\n");
+                return 2;
+            }
+            bool results[] = {left == right, left != right, left < right, left <= right, left > right, left >= right};
+            return !results[i];
+        }
+    }
+    fprintf(stderr,"Error -- test: unknown condition \'%s\'.\n", args[count > 1 ? 1 : 0]);
+    return 2;
+}
+
+/* -------------------- FUNCTIONS --------------------- */
+
+//Defines (or redefines) a shell function, registering it as an internal command whose body is a copy of the parsed statements.
+//The body is copied out of the script defining it, so the function still runs after that script's arena is reused.
+void define_function(STATEMENT *statement){
+    SCRIPT *body = calloc(1, sizeof(SCRIPT));
+    body->statements = copy_statements(body, statement->body);
+    int i = find_builtin(statement->variable);
+    if(i == -1){
+        i = register_builtin(strdup(statement->variable), &function_comm);
+    } else if(builtins[i].script != NULL){
+        //Frees the old body once no call is running it.
+        SCRIPT *old = builtins[i].script;
+        old->stale = true;
+        if(old->users == 0)
+            free_script(old);
+    }
+    builtins[i].function = &function_comm;
+    builtins[i].script = body;
+    set_exitcode(0);
+}
+
+//Calls a shell function, with its arguments as the positional parameters of a new frame.
+int function_comm(char **args){
+    SCRIPT *body = builtins[find_builtin(args[0])].script;
+    FRAME frame = {0};
+    push_frame(&frame, args);
+    //Loops around the call cannot be left from inside the function.
+    int loop_depth = LOOP_DEPTH;
+    LOOP_DEPTH = 0;
+    body->users++;
+    set_exitcode(0);
+    int status = execute_script(body);
+    body->users--;
+    if(body->stale && body->users == 0)
+        free_script(body);
+    LOOP_DEPTH = loop_depth;
+    RETURNING = false;
+    pop_frame(&frame);
+    return status;
+}
+
+//Makes a frame the running one, with the arguments after args[0] as its positional parameters.
+void push_frame(FRAME *frame, char **args){
+    //Copies the arguments, as the command calling the function may run again (and expand them into the same buffer) before it returns.
+    frame->args = copy_args(args);
+    for(frame->count=0;args[frame->count+1]!=NULL;frame->count++);
+    sprintf(frame->count_text, "%d", frame->count);
+    size_t size = 1;
+    for(int i=1;i<=frame->count;i++)
+        size += strlen(args[i]) + 1;
+    frame->all = malloc(size);
+    frame->all[0] = '\0';
+    for(int i=1, length=0;i<=frame->count;i++)
+        length += sprintf(frame->all + length, i == 1 ? "%s" : " %s", args[i]);
+    frame->previous = FRAMES;
+    FRAMES = frame;
+}
+
+//Returns to the frame of the caller, freeing the arguments and local variables of a frame.
+void pop_frame(FRAME *frame){
+    FRAMES = frame->previous;
+    for(int i=0;i<frame->local_count;i++){
+        free(frame->locals[i].name);
+        free(frame->locals[i].value);
+    }
+    free(frame->locals);
+    free(frame->all);
+    free(frame->args);
+}
+
+//Returns a copy of a NULL-terminated argument array in one allocation (freed with free()).
+char **copy_args(char **args){
+    int count = 0;
+    size_t size = 0;
+    for(;args[count]!=NULL;count++)
+        size += strlen(args[count]) + 1;
+    char **copy = malloc((count + 1) * sizeof(char *) + size), *text = (char *)(copy + count + 1);
+    for(int i=0;i<count;i++){
+        copy[i] = text;
+        text = stpcpy(text, args[i]) + 1;
+    }
+    copy[count] = NULL;
+    return copy;
+}
+
+//The 'local' internal command - Declares variables ('name' or 'name=value') that hide the ones with the same name until the running function returns.
+int local_comm(char **args){
+    if(FRAMES == NULL){
+        fprintf(stderr,"Error -- \'local\' can only be used in a function.\n");
+        set_exitcode(1 << 8);
+        return 1;
+    }
+    int status = 0;
+    for(int i=1;args[i]!=NULL;i++){
+        int length = name_length_of(args[i]);
+        if(length == 0 || (args[i][length] != '=' && args[i][length] != '\0')){
+            fprintf(stderr,"Error -- \'%s\' is not a valid variable name.\n", args[i]);
+            status = 1 << 8;
+            continue;
+        }
+        //Finds the variable among the ones the function already declared, or adds it.
+        LOCAL *local = NULL;
+        for(int l=0;l<FRAMES->local_count && local == NULL;l++){
+            if(strncmp(FRAMES->locals[l].name, args[i], length) == 0 && FRAMES->locals[l].name[length] == '\0')
+                local = &FRAMES->locals[l];
+        }
+        if(local == NULL){
+            if(FRAMES->local_count == FRAMES->local_capacity){
+                FRAMES->local_capacity = FRAMES->local_capacity == 0 ? 8 : FRAMES->local_capacity * 2;
+                FRAMES->locals = realloc(FRAMES->locals, FRAMES->local_capacity * sizeof(LOCAL));
+            }
+            local = &FRAMES->locals[FRAMES->local_count++];
+            *local = (LOCAL){strndup(args[i], length), NULL, 0};
+        }
+        set_local(local, args[i][length] == '=' ? args[i] + length + 1 : "");
+    }
+    set_exitcode(status);
+    return 1;
+}
+
+//The 'return' internal command - Leaves the running function, exiting with n ('return n') or the exit code of the last command.
+int return_comm(char **args){
+    if(FRAMES == NULL){
+        fprintf(stderr,"Error -- \'return\' can only be used in a function.\n");
+        set_exitcode(1 << 8);
+        return 1;
+    }
+    if(args[1] != NULL)
+        set_exitcode((atoi(args[1]) & 255) << 8);
+    RETURNING = true;
+    return 1;
+}
+
+/* --------------------- HISTORY ---------------------- */
+
+//Opens the history if the shell reads its statements from a terminal.
+void init_history(){
+    char *path = return_var_value("HISTFILE");
+    if(INTERACTIVE && path != NULL && path[0] != '\0')
+        open_history(path);
+}
+
+//Opens (or creates) the history files and maps them, without reading the log - so starting takes the same time with any number of entries.
+//Only entries missing from the index (e.g. if a shell was killed between writing the two) are found by scanning the end of the log.
+//Returns 1 on success, 0 otherwise.
+int open_history(char *path){
+    char name[MAX_SIZE];
+    snprintf(name, sizeof(name), "%s.index", path);
+    history.log_fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    history.index_fd = open(name, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if(history.log_fd == -1 || history.index_fd == -1){
+        perror("Error -- open()");
+        if(history.log_fd != -1)
+            close(history.log_fd);
+        if(history.index_fd != -1)
+            close(history.index_fd);
+        history.log_fd = history.index_fd = -1;
+        return 0;
+    }
+    history.path = strdup(path);
+    flock(history.log_fd, LOCK_EX);
+    map_history();
+    //Finds where the last indexed entry ends, rebuilding an index that does not match the log.
+    size_t end = 0;
+    if(history.count > 0){
+        uint64_t last = history.offsets[history.count - 1];
+        char *stop = last < history.log_size ? memchr(history.log + last, '\0', history.log_size - last) : NULL;
+        if(stop == NULL){
+            if(ftruncate(history.index_fd, 0) == -1)
+                perror("Error -- ftruncate()");
+            map_history();
+        } else {
+            end = stop - history.log + 1;
+        }
+    }
+    //Indexes the entries after it (an entry without its '\0' is still being written).
+    uint64_t offsets[512];
+    int count = 0;
+    char *stop;
+    while(end < history.log_size && (stop = memchr(history.log + end, '\0', history.log_size - end)) != NULL){
+        offsets[count++] = end;
+        end = stop - history.log + 1;
+        if(count == 512 || end >= history.log_size){
+            write_all(history.index_fd, (char *)offsets, count * sizeof(uint64_t));
+            count = 0;
+        }
+    }
+    if(count > 0)
+        write_all(history.index_fd, (char *)offsets, count * sizeof(uint64_t));
+    map_history();
+    map_sorted();
+    flock(history.log_fd, LOCK_UN);
+    return 1;
+}
+
+//Maps the log and the index again if entries were added to them (by any shell) since they were mapped.
+//Returns whether there were new entries.
+bool map_history(){
+    struct stat log_info, index_info;
+    //The index is checked first, so every entry it has is already in the log.
+    if(fstat(history.index_fd, &index_info) == -1 || fstat(history.log_fd, &log_info) == -1)
+        return false;
+    size_t count = index_info.st_size / sizeof(uint64_t);
+    if(count == history.count && (size_t)log_info.st_size == history.log_size)
+        return false;
+    if(history.log != NULL)
+        munmap(history.log, history.log_size);
+    if(history.offsets != NULL)
+        munmap(history.offsets, history.count * sizeof(uint64_t));
+    history.log = map_file(history.log_fd, log_info.st_size);
+    history.log_size = history.log == NULL ? 0 : log_info.st_size;
+    history.offsets = map_file(history.index_fd, count * sizeof(uint64_t));
+    history.count = history.offsets == NULL ? 0 : count;
+    return true;
+}
+
+//Maps the sorted index, ignoring one with more entries than the log (e.g. left behind when the log was deleted).
+void map_sorted(){
+    if(history.sorted != NULL)
+        munmap(history.sorted, history.sorted_count * sizeof(uint32_t));
+    history.sorted = NULL;
+    history.sorted_count = 0;
+    char name[MAX_SIZE];
+    snprintf(name, sizeof(name), "%s.sorted", history.path);
+    int fd = open(name, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return;
+    struct stat info;
+    if(fstat(fd, &info) == 0 && info.st_size / sizeof(uint32_t) <= history.count){
+        history.sorted_count = info.st_size / sizeof(uint32_t);
+        history.sorted = map_file(fd, history.sorted_count * sizeof(uint32_t));
+        if(history.sorted == NULL)
+            history.sorted_count = 0;
+    }
+    close(fd);
+}
+
+//Maps the first 'size' bytes of a file for reading (NULL if there are none).
+void *map_file(int fd, size_t size){
+    if(size == 0)
+        return NULL;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+//Appends a statement to the history (without the newline ending it), under a lock shared by every shell using the file.
+void add_history(char *text, size_t length){
+    while(length > 0 && text[length - 1] == '\n')
+        length--;
+    //Skips blank statements, and the ones the log could not keep.
+    if(history.path == NULL || strspn(text, DELIMITERS) >= length || memchr(text, '\0', length) != NULL)
+        return;
+    flock(history.log_fd, LOCK_EX);
+    uint64_t offset = lseek(history.log_fd, 0, SEEK_END);
+    struct iovec entry[] = {{text, length}, {"", 1}};
+    //The entry is written at once, so the index never has the offset of an entry that is not in the log.
+    if(writev(history.log_fd, entry, 2) == (ssize_t)length + 1)
+        write_all(history.index_fd, (char *)&offset, sizeof(offset));
+    else
+        perror("Error -- writev()");
+    flock(history.log_fd, LOCK_UN);
+}
+
+//Returns the text of entry n (counting from 0), or NULL if there is no such entry.
+char *history_entry(size_t n){
+    if(n >= history.count)
+        map_history();
+    if(n >= history.count || history.offsets[n] >= history.log_size)
+        return NULL;
+    return history.log + history.offsets[n];
+}
+
+//Returns the number of the newest entry before 'before' (or of all if it is -1) starting with the prefix, or -1 if there is none.
+//Searching again before the entry found steps back through the matches, like the reverse search of a terminal.
+long search_history(char *prefix, long before){
+    map_history();
+    size_t length = strlen(prefix);
+    if(before < 0 || before > (long)history.count)
+        before = history.count;
+    //The entries that are not sorted yet are searched from the newest.
+    for(long n = before - 1; n >= (long)history.sorted_count; n--){
+        char *entry = history_entry(n);
+        if(entry != NULL && strncmp(entry, prefix, length) == 0)
+            return n;
+    }
+    //The sorted index keeps the entries starting with the prefix together, so only their numbers are compared.
+    long found = -1;
+    size_t end = sorted_bound(prefix, length, true);
+    for(size_t i = sorted_bound(prefix, length, false); i < end; i++){
+        if((long)history.sorted[i] < before && (long)history.sorted[i] > found)
+            found = history.sorted[i];
+    }
+    return found;
+}
+
+//Binary searches the sorted index for the first entry starting with the prefix (or, if 'after' is set, the first entry after those).
+size_t sorted_bound(char *prefix, size_t length, bool after){
+    size_t low = 0, high = history.sorted_count;
+    while(low < high){
+        size_t middle = low + (high - low) / 2;
+        //An entry missing from a damaged log sorts first.
+        char *entry = history_entry(history.sorted[middle]);
+        int order = strncmp(entry != NULL ? entry : "", prefix, length);
+        if(order < 0 || (after && order == 0))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+//Orders entry numbers by the text of their entries (equal entries from the oldest), for qsort().
+int compare_history(const void *a, const void *b){
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    char *first = history_entry(x), *second = history_entry(y);
+    int order = strcmp(first != NULL ? first : "", second != NULL ? second : "");
+    return order != 0 ? order : (x > y) - (x < y);
+}
+
+//Replaces the history references of a line typed into the terminal with the entries they name -
+//'!!' (the last entry), '!n' (entry n), '!-n' (the nth last entry) and '!prefix' (the last entry starting with the prefix).
+//A '!' in single quotes, after a '\', or followed by a blank, '=' or '(' is left alone (e.g. in 'test a != b').
+//Returns the new line (to be freed), or NULL if it has no references; sets 'error' if an entry does not exist.
+char *expand_history(char *line, bool *error){
+    *error = false;
+    if(history.path == NULL)
+        return NULL;
+    size_t capacity = strlen(line) + 1, length = 0;
+    char *result = malloc(capacity);
+    bool replaced = false;
+    char quote = '\0';
+    map_history();
+    for(char *p = line; *p != '\0';){
+        //The part of the line copied (a character, an escaped one, or the entry a reference names).
+        char *piece = p;
+        size_t size = (*p == '\\' && p[1] != '\0' && quote != '\'') ? 2 : 1;
+        char *next = p + size;
+        if((*p == '\'' && quote != '"') || (*p == '"' && quote != '\''))
+            quote = quote == '\0' ? *p : '\0';
+        if(*p == '!' && quote != '\''){
+            char *q = p + 1;
+            long n = -1;
+            if(*q == '!'){
+                n = (long)history.count - 1;
+                q++;
+            } else if(isdigit(*q) || (*q == '-' && isdigit(q[1]))){
+                long number = strtol(q, &q, 10);
+                n = number < 0 ? (long)history.count + number : number - 1;
+            } else if(*q != '\0' && strchr(DELIMITERS "=();|&<>\"'", *q) == NULL){
+                q += strcspn(q, DELIMITERS ";|&<>\"'");
+                char *prefix = strndup(p + 1, q - p - 1);
+                n = search_history(prefix, -1);
+                free(prefix);
+            }
+            if(q != p + 1){
+                piece = n >= 0 ? history_entry(n) : NULL;
+                if(piece == NULL){
+                    fprintf(stderr,"Error -- %.*s: event not found.\n", (int)(q - p), p);
+                    free(result);
+                    *error = true;
+                    return NULL;
+                }
+                size = strlen(piece);
+                next = q;
+                replaced = true;
+            }
+        }
+        if(length + size + 1 > capacity){
+            capacity = 2 * (length + size + 1);
+            result = realloc(result, capacity);
+        }
+        memcpy(result + length, piece, size);
+        length += size;
+        p = next;
+    }
+    result[length] = '\0';
+    if(!replaced){
+        free(result);
+        return NULL;
+    }
+    return result;
+}
+
+//Merges the entries added since the sorted index was written into it, once there are enough of them to slow down searches.
+//The new index replaces the file at once, so other shells keep using the one they mapped.
+void sort_history(){
+    flock(history.log_fd, LOCK_EX);
+    //Another shell may have sorted entries since this one mapped the index.
+    map_history();
+    map_sorted();
+    size_t sorted = history.sorted_count, count = history.count;
+    if(count - sorted < HISTORY_UNSORTED_LIMIT || count > UINT32_MAX){
+        flock(history.log_fd, LOCK_UN);
+        return;
+    }
+    uint32_t *added = malloc((count - sorted) * sizeof(uint32_t));
+    uint32_t *merged = malloc(count * sizeof(uint32_t));
+    for(size_t n = sorted; n < count; n++)
+        added[n - sorted] = n;
+    qsort(added, count - sorted, sizeof(uint32_t), compare_history);
+    for(size_t i = 0, j = 0, k = 0; k < count; k++){
+        if(j == count - sorted || (i < sorted && compare_history(&history.sorted[i], &added[j]) < 0))
+            merged[k] = history.sorted[i++];
+        else
+            merged[k] = added[j++];
+    }
+    char name[MAX_SIZE], temporary[MAX_SIZE];
+    snprintf(name, sizeof(name), "%s.sorted", history.path);
+    snprintf(temporary, sizeof(temporary), "%s.sorted.%d", history.path, (int)getpid());
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if(fd == -1){
+        perror("Error -- open()");
+    } else if(write_all(fd, (char *)merged, count * sizeof(uint32_t)) == -1 || close(fd) == -1 || rename(temporary, name) == -1){
+        perror("Error -- sort_history()");
+        unlink(temporary);
+    }
+    free(added);
+    free(merged);
+    map_sorted();
+    flock(history.log_fd, LOCK_UN);
+}
+
+//Sorts the new entries into the index and unmaps the history when the shell exits.
+void close_history(){
+    if(history.path == NULL)
+        return;
+    sort_history();
+    if(history.log != NULL)
+        munmap(history.log, history.log_size);
+    if(history.offsets != NULL)
+        munmap(history.offsets, history.count * sizeof(uint64_t));
+    if(history.sorted != NULL)
+        munmap(history.sorted, history.sorted_count * sizeof(uint32_t));
+    close(history.log_fd);
+    close(history.index_fd);
+    free(history.path);
+    history = (HISTORY){.log_fd = -1, .index_fd = -1};
+}
+
+//The 'history' internal command - Displays the history ('history n' displays the last n entries), or the entries starting with a prefix ('history -s prefix'), newest first.
+int history_comm(char **args){
+    if(history.path == NULL){
+        fprintf(stderr,"Error -- The history is only kept for statements typed into the terminal.\n");
+        set_exitcode(1 << 8);
+        return 1;
+    }
+    map_history();
+    if(args[1] != NULL && strcmp(args[1], "-s") == 0){
+        if(args[2] == NULL){
+            fprintf(stderr,"Error -- No prefix inputted after \'history -s\'.\n");
+            set_exitcode(1 << 8);
+            return 1;
+        }
+        //Marks the sorted entries starting with the prefix, so every match is displayed in order without searching again.
+        size_t length = strlen(args[2]), end = sorted_bound(args[2], length, true);
+        unsigned char *found = calloc(history.count / 8 + 1, 1);
+        for(size_t i = sorted_bound(args[2], length, false); i < end; i++)
+            found[history.sorted[i] / 8] |= 1 << (history.sorted[i] % 8);
+        for(size_t n = history.count; n-- > 0;){
+            char *entry = history_entry(n);
+            if(entry != NULL && (n >= history.sorted_count ? strncmp(entry, args[2], length) == 0 : (found[n / 8] >> (n % 8)) & 1))
+                printf("%5zu  %s\n", n + 1, entry);
+        }
+        free(found);
+        set_exitcode(0);
+        return 1;
+    }
+    size_t first = 0;
+    if(args[1] != NULL){
+        char *end;
+        long last = strtol(args[1], &end, 10);
+        if(*end != '\0' || last < 0){
+            fprintf(stderr,"Error -- \'%s\' is not a number of entries.\n", args[1]);
+            set_exitcode(1 << 8);
+            return 1;
+        }
+        first = (size_t)last < history.count ? history.count - last : 0;
+    }
+    //Skips the entries missing from a damaged log.
+    for(size_t n = first; n < history.count; n++){
+        char *entry = history_entry(n);
+        if(entry != NULL)
+            printf("%5zu  %s\n", n + 1, entry);
+    }
+    set_exitcode(0);
+    return 1;
+}
+
+/* ------------------- LINE EDITOR -------------------- */
+
+//Reads a line from the terminal in raw mode, letting it be edited before it is returned like getline() would (ending in '\n').
+//Besides the arrows, 'Home', 'End', 'Delete' and the usual Ctrl keys, it completes words with Tab, goes through the history with Up and Down,
+//and searches it with Ctrl-R. Returns -1 at the end of the input, or 0 if the statement was cancelled with Ctrl-C.
+ssize_t edit_line(READER *reader){
+    struct termios saved, raw;
+    if(tcgetattr(STDIN_FILENO, &saved) == -1)
+        return getline(&reader->line, &reader->line_capacity, reader->input);
+    raw = saved;
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    raw.c_iflag &= ~(IXON | ICRNL);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &raw);
+    fflush(stdout);
+    if(history.path != NULL)
+        map_history();
+    EDITOR editor = {reader->line, 0, reader->line_capacity, 0, 0, reader->length == 0, history.count, NULL};
+    if(editor.capacity < MAX_SIZE){
+        editor.capacity = MAX_SIZE;
+        editor.line = realloc(editor.line, editor.capacity);
+    }
+    ssize_t result = -2;
+    int key, pending = 0, last = 0;
+    while(result == -2){
+        key = pending != 0 ? pending : read_key();
+        pending = 0;
+        switch(key){
+            case -1: //The end of the input.
+            case 4: //Ctrl-D - also deletes the character under the cursor.
+                if(editor.length == 0 || key == -1)
+                    result = editor.length == 0 ? -1 : (ssize_t)editor.length + 1;
+                else
+                    delete_text(&editor, editor.cursor, editor.cursor + 1);
+                break;
+            case '\r':
+            case '\n':
+                result = editor.length + 1;
+                break;
+            case 3: //Ctrl-C
+                editor.cursor = editor.length;
+                draw_line(&editor, editor.line, editor.length, editor.cursor);
+                printf("^C");
+                result = 0;
+                break;
+            case 127: //Backspace
+            case 8:
+                if(editor.cursor > 0)
+                    delete_text(&editor, editor.cursor - 1, editor.cursor);
+                break;
+            case KEY_DELETE:
+                delete_text(&editor, editor.cursor, editor.cursor + 1);
+                break;
+            case KEY_LEFT:
+            case 2: //Ctrl-B
+                if(editor.cursor > 0)
+                    editor.cursor--;
+                break;
+            case KEY_RIGHT:
+            case 6: //Ctrl-F
+                if(editor.cursor < editor.length)
+                    editor.cursor++;
+                break;
+            case KEY_HOME:
+            case 1: //Ctrl-A
+                editor.cursor = 0;
+                break;
+            case KEY_END:
+            case 5: //Ctrl-E
+                editor.cursor = editor.length;
+                break;
+            case 11: //Ctrl-K - deletes the rest of the line.
+                delete_text(&editor, editor.cursor, editor.length);
+                break;
+            case 21: //Ctrl-U - deletes the line before the cursor.
+                delete_text(&editor, 0, editor.cursor);
+                break;
+            case 23: { //Ctrl-W - deletes the word before the cursor.
+                size_t start = editor.cursor;
+                while(start > 0 && isblank((unsigned char)editor.line[start - 1]))
+                    start--;
+                while(start > 0 && !isblank((unsigned char)editor.line[start - 1]))
+                    start--;
+                delete_text(&editor, start, editor.cursor);
+                break;
+            }
+            case 12: //Ctrl-L - clears the screen.
+                printf("\x1b[H\x1b[2J");
+                redraw_line(&editor);
+                break;
+            case KEY_UP:
+            case 16: //Ctrl-P
+                show_history(&editor, editor.position - 1);
+                break;
+            case KEY_DOWN:
+            case 14: //Ctrl-N
+                show_history(&editor, editor.position + 1);
+                break;
+            case '\t':
+                complete(&editor, last == '\t');
+                break;
+            case 18: //Ctrl-R
+                pending = reverse_search(&editor);
+                break;
+            default:
+                if(key >= 32 && key < 256 && key != 127){
+                    char c = key;
+                    insert_text(&editor, &c, 1);
+                }
+        }
+        //Draws the line, or moves the cursor to its end before the newline.
+        if(result > 0)
+            editor.cursor = editor.length;
+        if(result != 0 && result != -1)
+            draw_line(&editor, editor.line, editor.length, editor.cursor);
+        last = key;
+    }
+    if(result != -1)
+        printf("\n");
+    fflush(stdout);
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &saved);
+    editor.line[editor.length] = '\n';
+    editor.line[editor.length + 1] = '\0';
+    reader->line = editor.line;
+    reader->line_capacity = editor.capacity;
+    free(editor.typed);
+    return result;
+}
+
+//Reads a key from the terminal, turning the escape sequences of the arrows, 'Home', 'End' and 'Delete' into their KEY_ codes.
+//Returns -1 at the end of the input.
+int read_key(){
+    int c = read_byte(-1);
+    if(c != 27)
+        return c;
+    //An escape on its own is not followed by the rest of a sequence straight away.
+    int kind = read_byte(50);
+    if(kind != '[' && kind != 'O')
+        return 27;
+    int code = read_byte(50);
+    switch(code){
+        case 'A': return KEY_UP;
+        case 'B': return KEY_DOWN;
+        case 'C': return KEY_RIGHT;
+        case 'D': return KEY_LEFT;
+        case 'H': return KEY_HOME;
+        case 'F': return KEY_END;
+    }
+    //Sequences such as 'ESC [ 3 ~'.
+    if(!isdigit(code))
+        return 27;
+    int end;
+    while((end = read_byte(50)) != -1 && isdigit(end));
+    if(end != '~')
+        return 27;
+    if(code == '1' || code == '7')
+        return KEY_HOME;
+    if(code == '4' || code == '8')
+        return KEY_END;
+    return code == '3' ? KEY_DELETE : 27;
+}
+
+//Reads a byte from the terminal, waiting at most 'timeout' milliseconds (or forever if it is -1).
+//Returns -1 at the end of the input or if nothing came in time.
+int read_byte(int timeout){
+    struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+    unsigned char c;
+    while(true){
+        int ready = poll(&input, 1, timeout);
+        if(ready == -1 && errno == EINTR)
+            continue;
+        if(ready <= 0)
+            return -1;
+        ssize_t n = read(STDIN_FILENO, &c, 1);
+        if(n == -1 && errno == EINTR)
+            continue;
+        return n == 1 ? c : -1;
+    }
+}
+
+//Draws text in place of the line on the screen, with the cursor at 'cursor'.
+void draw_line(EDITOR *editor, char *text, size_t length, size_t cursor){
+    if(editor->drawn > 0)
+        printf("\x1b[%zuD", editor->drawn);
+    fwrite(text, 1, length, stdout);
+    printf("\x1b[K");
+    if(length > cursor)
+        printf("\x1b[%zuD", length - cursor);
+    editor->drawn = cursor;
+    fflush(stdout);
+}
+
+//Draws the prompt and the line again on a new line of the screen.
+void redraw_line(EDITOR *editor){
+    if(editor->first)
+        printf("%s", return_var_value("PROMPT"));
+    editor->drawn = 0;
+    draw_line(editor, editor->line, editor->length, editor->cursor);
+}
+
+//Inserts text at the cursor, moving the cursor after it.
+void insert_text(EDITOR *editor, char *text, size_t length){
+    //Keeps room for the '\n' and '\0' ending the line.
+    if(editor->length + length + 2 > editor->capacity){
+        editor->capacity = 2 * (editor->length + length + 2);
+        editor->line = realloc(editor->line, editor->capacity);
+    }
+    memmove(editor->line + editor->cursor + length, editor->line + editor->cursor, editor->length - editor->cursor);
+    memcpy(editor->line + editor->cursor, text, length);
+    editor->length += length;
+    editor->cursor += length;
+}
+
+//Deletes the characters from 'start' to 'end', leaving the cursor at 'start'.
+void delete_text(EDITOR *editor, size_t start, size_t end){
+    if(end > editor->length)
+        end = editor->length;
+    if(start >= end)
+        return;
+    memmove(editor->line + start, editor->line + end, editor->length - end);
+    editor->length -= end - start;
+    editor->cursor = start;
+}
+
+//Replaces the line, with the cursor at its end.
+void set_line(EDITOR *editor, char *text){
+    editor->length = editor->cursor = 0;
+    insert_text(editor, text, strlen(text));
+}
+
+//Shows a history entry in place of the line (or, past the newest entry, the line that was being typed).
+void show_history(EDITOR *editor, long position){
+    if(history.path == NULL || position < 0 || position > (long)history.count || position == editor->position){
+        printf("\a");
+        return;
+    }
+    //Keeps the typed line when leaving it.
+    if(editor->position == (long)history.count){
+        free(editor->typed);
+        editor->typed = strndup(editor->line, editor->length);
+    }
+    editor->position = position;
+    char *entry = position == (long)history.count ? editor->typed : history_entry(position);
+    set_line(editor, entry != NULL ? entry : "");
+}
+
+//Searches the history back from the newest entry for the prefix typed, like the reverse search of other shells -
+//Ctrl-R again finds an older match, Ctrl-G (or Escape) goes back to the line, and any other key edits the match.
+//Returns the key that ended the search for the editor to handle (e.g. Enter, to run the match), or 0.
+int reverse_search(EDITOR *editor){
+    if(history.path == NULL){
+        printf("\a");
+        return 0;
+    }
+    char query[MAX_SIZE];
+    size_t length = 0;
+    long found = -1;
+    bool failed = false;
+    query[0] = '\0';
+    while(true){
+        char *entry = found != -1 ? history_entry(found) : "";
+        if(entry == NULL)
+            entry = "";
+        char *display;
+        int size = asprintf(&display, "(%sreverse-i-search)`%s': %s", failed ? "failed " : "", query, entry);
+        if(size == -1)
+            return 0;
+        draw_line(editor, display, size, size);
+        free(display);
+        int key = read_key();
+        if(key == 18){
+            //Finds an older match.
+            long older = search_history(query, found);
+            if(older != -1)
+                found = older;
+            else
+                printf("\a");
+        } else if(key == 127 || key == 8 || (key >= 32 && key < 256 && length + 1 < sizeof(query))){
+            //Searches again from the newest entry with the new prefix.
+            if(key == 127 || key == 8)
+                length -= length > 0;
+            else
+                query[length++] = key;
+            query[length] = '\0';
+            long match = search_history(query, -1);
+            failed = match == -1;
+            if(!failed)
+                found = match;
+        } else if(key == 7 || key == 27 || key == 3){
+            return 0;
+        } else {
+            if(found != -1 && history_entry(found) != NULL)
+                set_line(editor, history_entry(found));
+            return key;
+        }
+    }
+}
+
+//Completes the word before the cursor with the longest prefix its matches share (and a space once the word is complete).
+//If there is nothing to add, 'list' (a second Tab) displays the matches.
+void complete(EDITOR *editor, bool list){
+    COMPLETIONS completions = {0};
+    size_t start;
+    if(find_completions(editor->line, editor->cursor, &start, &completions) == 0){
+        printf("\a");
+        return;
+    }
+    char *first = completions.matches[0];
+    size_t common = strlen(first);
+    bool unique = true;
+    for(int i=1;i<completions.count;i++){
+        size_t j = 0;
+        while(j < common && completions.matches[i][j] == first[j])
+            j++;
+        common = j;
+        unique &= strcmp(completions.matches[i], first) == 0;
+    }
+    size_t typed = editor->cursor - start;
+    if(common > typed)
+        insert_text(editor, first + typed, common - typed);
+    if(unique && first[common - 1] != '/')
+        insert_text(editor, " ", 1);
+    else if(common <= typed && !unique){
+        if(list)
+            list_completions(editor, &completions);
+        else
+            printf("\a");
+    }
+    free_completions(&completions);
+}
+
+//Displays the completions in columns under the line, asking first if there are many of them, then draws the line again.
+void list_completions(EDITOR *editor, COMPLETIONS *completions){
+    qsort(completions->matches, completions->count, sizeof(char *), compare_names);
+    //Removes the names found more than once (e.g. an internal command that is also on PATH).
+    int count = 0;
+    size_t width = 0;
+    for(int i=0;i<completions->count;i++){
+        if(count > 0 && strcmp(completions->matches[i], completions->matches[count - 1]) == 0){
+            free(completions->matches[i]);
+            continue;
+        }
+        completions->matches[count++] = completions->matches[i];
+        if(strlen(completions->matches[i]) > width)
+            width = strlen(completions->matches[i]);
+    }
+    completions->count = count;
+    printf("\n");
+    if(count > COMPLETION_LIST_LIMIT){
+        printf("Display all %d possibilities? (y or n)", count);
+        fflush(stdout);
+        int key = read_key();
+        printf("\n");
+        if(key != 'y' && key != 'Y'){
+            redraw_line(editor);
+            return;
+        }
+    }
+    //Fills the columns top to bottom, as wide as the terminal allows.
+    struct winsize size;
+    int columns = 80;
+    if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0)
+        columns = size.ws_col;
+    width += 2;
+    int per_row = columns / (int)width > 0 ? columns / (int)width : 1;
+    int rows = (count + per_row - 1) / per_row;
+    for(int row=0;row<rows;row++){
+        for(int i=row;i<count;i+=rows)
+            printf("%-*s", i + rows < count ? (int)width : 0, completions->matches[i]);
+        printf("\n");
+    }
+    redraw_line(editor);
+}
+
+//Finds the words completing the one before the cursor - variable names after '$', internal commands and executables on PATH where a command goes, and files otherwise.
+//Sets 'start' to where the word starts. Returns the number of matches.
+int find_completions(char *line, size_t cursor, size_t *start, COMPLETIONS *completions){
+    size_t begin = cursor;
+    while(begin > 0 && strchr(DELIMITERS ";|&<>()", line[begin - 1]) == NULL)
+        begin--;
+    *start = begin;
+    char *word = strndup(line + begin, cursor - begin);
+    size_t length = cursor - begin;
+    if(word[0] == '$'){
+        for(int i=0;i<VAR_SIZE;i++){
+            if(variables[i].name != NULL && strncmp(variables[i].name, word + 1, length - 1) == 0)
+                add_completion(completions, "$", variables[i].name, "");
+        }
+    } else if(strchr(word, '/') == NULL && command_position(line, begin)){
+        for(int i=0;i<BUILTIN_COUNT;i++){
+            if(strncmp(builtins[i].name, word, length) == 0)
+                add_completion(completions, "", builtins[i].name, "");
+        }
+        //The matching executables are next to each other in the catalog (the same name can be in several directories).
+        pthread_mutex_lock(&catalog.lock);
+        for(size_t i = catalog_position(word, 0); i < catalog.count && strncmp(catalog.entries[i].name, word, length) == 0; i++){
+            if(i == 0 || strcmp(catalog.entries[i].name, catalog.entries[i - 1].name) != 0)
+                add_completion(completions, "", catalog.entries[i].name, "");
+        }
+        pthread_mutex_unlock(&catalog.lock);
+    } else {
+        //Lists the directory of the word, completing the part after its last '/'.
+        char *slash = strrchr(word, '/');
+        char *base = slash == NULL ? word : slash + 1;
+        char *directory = slash == NULL ? strdup(".") : slash == word ? strdup("/") : strndup(word, slash - word);
+        char *prefix = strndup(word, base - word);
+        DIR *dir = opendir(directory);
+        struct dirent *entry;
+        while(dir != NULL && (entry = readdir(dir)) != NULL){
+            char *name = entry->d_name;
+            if(strncmp(name, base, strlen(base)) != 0 || strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || (name[0] == '.' && base[0] != '.'))
+                continue;
+            bool is_directory = entry->d_type == DT_DIR;
+            if(entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK){
+                struct stat info;
+                char path[MAX_SIZE];
+                snprintf(path, sizeof(path), "%s/%s", directory, name);
+                is_directory = stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+            }
+            add_completion(completions, prefix, name, is_directory ? "/" : "");
+        }
+        if(dir != NULL)
+            closedir(dir);
+        free(directory);
+        free(prefix);
+    }
+    free(word);
+    return completions->count;
+}
+
+//Returns whether the word at 'start' is where a command name goes - at the start of the line, after an operator, or after a reserved word such as 'then'.
+bool command_position(char *line, size_t start){
+    size_t end = start;
+    while(end > 0 && isblank((unsigned char)line[end - 1]))
+        end--;
+    if(end == 0 || strchr(";|&(", line[end - 1]) != NULL)
+        return true;
+    size_t begin = end;
+    while(begin > 0 && !isblank((unsigned char)line[begin - 1]) && strchr(";|&()", line[begin - 1]) == NULL)
+        begin--;
+    char *word = strndup(line + begin, end - begin);
+    bool reserved = is_reserved(word) || strcmp(word, "!") == 0;
+    free(word);
+    return reserved;
+}
+
+//Adds a completion, joining its parts.
+void add_completion(COMPLETIONS *completions, char *prefix, char *name, char *suffix){
+    if(completions->count == completions->capacity){
+        completions->capacity = completions->capacity == 0 ? 64 : 2 * completions->capacity;
+        completions->matches = realloc(completions->matches, completions->capacity * sizeof(char *));
+    }
+    size_t prefix_length = strlen(prefix), name_length = strlen(name);
+    char *match = malloc(prefix_length + name_length + strlen(suffix) + 1);
+    memcpy(match, prefix, prefix_length);
+    memcpy(match + prefix_length, name, name_length);
+    strcpy(match + prefix_length + name_length, suffix);
+    completions->matches[completions->count++] = match;
+}
+
+//Frees a list of completions.
+void free_completions(COMPLETIONS *completions){
+    for(int i=0;i<completions->count;i++)
+        free(completions->matches[i]);
+    free(completions->matches);
+    *completions = (COMPLETIONS){0};
+}
+
+//Orders strings alphabetically, for qsort().
+int compare_names(const void *a, const void *b){
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+//Starts the thread keeping the catalog of executables on PATH, so completing a command never reads the PATH directories.
+void init_catalog(){
+    if(catalog.started || pipe2(catalog.wake, O_CLOEXEC) == -1)
+        return;
+    char *path = return_var_value("PATH");
+    catalog.path = strdup(path != NULL ? path : "");
+    //The thread blocks every signal, so they are handled by the shell's thread.
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    pthread_t thread;
+    int error = pthread_create(&thread, NULL, &catalog_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if(error != 0){
+        fprintf(stderr,"Error -- pthread_create(): %s\n", strerror(error));
+        return;
+    }
+    pthread_detach(thread);
+    catalog.started = true;
+}
+
+//Has the thread index a new PATH.
+void refresh_catalog(char *path){
+    if(!catalog.started)
+        return;
+    pthread_mutex_lock(&catalog.lock);
+    free(catalog.path);
+    catalog.path = strdup(path);
+    pthread_mutex_unlock(&catalog.lock);
+    if(write(catalog.wake[1], "", 1) == -1)
+        perror("Error -- write()");
+}
+
+//Indexes PATH, then applies the changes inotify reports in its directories until the shell exits (or PATH changes, and it starts again).
+void *catalog_thread(void *unused){
+    int inotify = -1;
+    char *path = NULL;
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while(true){
+        pthread_mutex_lock(&catalog.lock);
+        char *next = catalog.path;
+        catalog.path = NULL;
+        pthread_mutex_unlock(&catalog.lock);
+        if(next != NULL){
+            free(path);
+            path = next;
+            if(inotify != -1)
+                close(inotify);
+            inotify = inotify_init1(IN_CLOEXEC);
+            index_path(path, inotify);
+        }
+        struct pollfd fds[] = {{catalog.wake[0], POLLIN, 0}, {inotify, POLLIN, 0}};
+        if(poll(fds, 2, -1) == -1)
+            continue;
+        if(fds[0].revents & POLLIN){
+            char buffer[64];
+            if(read(catalog.wake[0], buffer, sizeof(buffer)) == -1)
+                continue;
+        }
+        if(fds[1].revents & POLLIN){
+            ssize_t n = read(inotify, events, sizeof(events));
+            struct inotify_event *event;
+            for(char *p = events; n > 0 && p < events + n; p += sizeof(struct inotify_event) + event->len){
+                event = (struct inotify_event *)p;
+                //Indexes everything again if changes were lost.
+                if(event->mask & IN_Q_OVERFLOW){
+                    pthread_mutex_lock(&catalog.lock);
+                    if(catalog.path == NULL)
+                        catalog.path = strdup(path);
+                    pthread_mutex_unlock(&catalog.lock);
+                } else {
+                    update_catalog(event);
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+//Lists the executables in the directories of a PATH and replaces the catalog with them, watching the directories for changes.
+//The list is built before the lock is taken, so completion is not held up while the directories are read.
+void index_path(char *path, int inotify){
+    for(int i=0;i<catalog.directory_count;i++)
+        free(catalog.directories[i]);
+    catalog.directory_count = 0;
+    EXECUTABLE *entries = NULL;
+    size_t count = 0, capacity = 0;
+    char *copy = strdup(path), *save;
+    for(char *directory = strtok_r(copy, ":", &save); directory != NULL; directory = strtok_r(NULL, ":", &save)){
+        int watch = inotify == -1 ? -1 : inotify_add_watch(inotify, directory, CATALOG_EVENTS);
+        //Skips a directory that is in PATH twice.
+        bool seen = false;
+        for(int i=0;i<catalog.directory_count && watch != -1;i++)
+            seen |= catalog.watches[i] == watch;
+        if(seen)
+            continue;
+        int d = catalog.directory_count++;
+        catalog.directories = realloc(catalog.directories, catalog.directory_count * sizeof(char *));
+        catalog.watches = realloc(catalog.watches, catalog.directory_count * sizeof(int));
+        catalog.directories[d] = strdup(directory);
+        catalog.watches[d] = watch;
+        DIR *dir = opendir(directory);
+        struct dirent *entry;
+        while(dir != NULL && (entry = readdir(dir)) != NULL){
+            if(entry->d_name[0] == '.' || !is_executable_in(directory, entry->d_name))
+                continue;
+            if(count == capacity){
+                capacity = capacity == 0 ? 1024 : 2 * capacity;
+                entries = realloc(entries, capacity * sizeof(EXECUTABLE));
+            }
+            entries[count++] = (EXECUTABLE){strdup(entry->d_name), d};
+        }
+        if(dir != NULL)
+            closedir(dir);
+    }
+    free(copy);
+    qsort(entries, count, sizeof(EXECUTABLE), compare_executables);
+    pthread_mutex_lock(&catalog.lock);
+    EXECUTABLE *old = catalog.entries;
+    size_t old_count = catalog.count;
+    catalog.entries = entries;
+    catalog.count = count;
+    catalog.capacity = capacity;
+    catalog.ready = true;
+    pthread_mutex_unlock(&catalog.lock);
+    for(size_t i=0;i<old_count;i++)
+        free(old[i].name);
+    free(old);
+}
+
+//Adds or removes the file an inotify event is about, depending on whether it is an executable now.
+void update_catalog(struct inotify_event *event){
+    int d = 0;
+    while(d < catalog.directory_count && catalog.watches[d] != event->wd)
+        d++;
+    if(d == catalog.directory_count || event->len == 0)
+        return;
+    bool present = event->name[0] != '.' && is_executable_in(catalog.directories[d], event->name);
+    pthread_mutex_lock(&catalog.lock);
+    size_t i = catalog_position(event->name, d);
+    bool found = i < catalog.count && catalog.entries[i].directory == d && strcmp(catalog.entries[i].name, event->name) == 0;
+    if(present && !found){
+        if(catalog.count == catalog.capacity){
+            catalog.capacity = catalog.capacity == 0 ? 1024 : 2 * catalog.capacity;
+            catalog.entries = realloc(catalog.entries, catalog.capacity * sizeof(EXECUTABLE));
+        }
+        memmove(catalog.entries + i + 1, catalog.entries + i, (catalog.count - i) * sizeof(EXECUTABLE));
+        catalog.entries[i] = (EXECUTABLE){strdup(event->name), d};
+        catalog.count++;
+    } else if(!present && found){
+        free(catalog.entries[i].name);
+        memmove(catalog.entries + i, catalog.entries + i + 1, (catalog.count - i - 1) * sizeof(EXECUTABLE));
+        catalog.count--;
+    }
+    pthread_mutex_unlock(&catalog.lock);
+}
+
+//Returns whether a file in a directory is an executable (a regular file with an execute permission).
+bool is_executable_in(char *directory, char *name){
+    char path[MAX_SIZE];
+    struct stat info;
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    return stat(path, &info) == 0 && S_ISREG(info.st_mode) && (info.st_mode & 0111) != 0;
+}
+
+//Binary searches the catalog for the position of an executable (where it would be inserted if it is not in it).
+size_t catalog_position(char *name, int directory){
+    EXECUTABLE key = {name, directory};
+    size_t low = 0, high = catalog.count;
+    while(low < high){
+        size_t middle = low + (high - low) / 2;
+        if(compare_executables(&catalog.entries[middle], &key) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+//Orders executables by name, then by the position of their directory in PATH, for qsort().
+int compare_executables(const void *a, const void *b){
+    const EXECUTABLE *x = a, *y = b;
+    int order = strcmp(x->name, y->name);
+    return order != 0 ? order : x->directory - y->directory;
+}
+
+/* ---------------------- SERVER ---------------------- */
+
+//Runs the shell as a server on a Unix socket, so a caller running many scripts does not start a shell for each of them.
+//The server sets the shell up once and forks workers from it, each waiting for a request. A worker runs one request with its own copy
+//of the variables and its own working directory, then exits and is replaced - so no request sees what another one changed.
+int run_server(char *path, int workers){
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if(strlen(path) >= sizeof(address.sun_path)){
+        fprintf(stderr,"Error -- The socket path \'%s\' is too long.\n", path);
+        return 2;
+    }
+    strcpy(address.sun_path, path);
+    //Replaces the socket a stopped server left behind.
+    unlink(path);
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(listener == -1 || bind(listener, (struct sockaddr *)&address, sizeof(address)) == -1 || listen(listener, SOMAXCONN) == -1){
+        perror("Error -- run_server()");
+        return 1;
+    }
+    if(workers < 1)
+        workers = SERVER_WORKERS;
+    pid_t *pool = malloc(workers * sizeof(pid_t));
+    for(int i=0;i<workers;i++)
+        pool[i] = start_worker(listener, getpid());
+    //Starts a new worker whenever one finishes its request.
+    while(true){
+        pid_t pid = waitpid(-1, NULL, 0);
+        if(pid == -1 && errno == EINTR)
+            continue;
+        if(pid == -1){
+            perror("Error -- waitpid()");
+            break;
+        }
+        for(int i=0;i<workers;i++){
+            if(pool[i] == pid)
+                pool[i] = start_worker(listener, getpid());
+        }
+    }
+    free(pool);
+    close(listener);
+    unlink(path);
+    return 1;
+}
+
+//Forks a worker that serves one request, returning its pid (-1 if it could not be forked).
+pid_t start_worker(int listener, pid_t server){
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == -1)
+        perror("Error -- fork()");
+    if(pid == 0){
+        //Stops with the server while it waits (if the server already stopped, the worker is not its child any more).
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if(getppid() != server)
+            _exit(0);
+        _exit(serve_request(listener));
+    }
+    return pid;
+}
+
+//Waits for a request in a worker, and runs its script with the client's stdin, stdout, stderr and working directory, sending back its exit code.
+//Returns the exit code of the worker.
+int serve_request(int listener){
+    int connection;
+    while((connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC)) == -1 && errno == EINTR);
+    if(connection == -1){
+        perror("Error -- accept()");
+        return 1;
+    }
+    close(listener);
+    //Finishes the request even if the server stops meanwhile.
+    prctl(PR_SET_PDEATHSIG, 0);
+    SERVER_REQUEST request;
+    int fds[3];
+    if(receive_fds(connection, &request, sizeof(request), fds, 3) != 3){
+        fprintf(stderr,"Error -- A request came without its stdin, stdout and stderr.\n");
+        return 1;
+    }
+    char *script = malloc(request.script_length + 1), *cwd = malloc(request.cwd_length + 1);
+    if(read_all(connection, script, request.script_length) == -1 || read_all(connection, cwd, request.cwd_length) == -1){
+        fprintf(stderr,"Error -- A request ended before its script.\n");
+        return 1;
+    }
+    script[request.script_length] = '\0';
+    cwd[request.cwd_length] = '\0';
+    //Runs the script as if the client had started the shell.
+    for(int i=0;i<3;i++){
+        if(fds[i] != i){
+            dup2(fds[i], i);
+            close(fds[i]);
+        }
+    }
+    if(chdir(cwd) == -1)
+        perror("Error -- chdir()");
+    set_cwd();
+    init_jobs();
+    run_string(script);
+    fflush(stdout);
+    int32_t code = exit_status();
+    write_all(connection, (char *)&code, sizeof(code));
+    free(script);
+    free(cwd);
+    return 0;
 }
 
-void start(){
-    char *line, **args;
-    int status;
-    //Loops until the exit command is typed into shell terminal (returning 0).
-    do {
-        //Prints the command prompt.
-        printf("%s",return_var_value("PROMPT"));
-        //Reads line.
-        line = read_line();
-        //Tokenizes line.
-        args = split_line(line);
-        //Executes line.
-        status = execute(args);
-    } while (status != 0);
+//Sends a message with descriptors attached (SCM_RIGHTS), returning -1 on error.
+int send_fds(int socket, void *data, size_t size, int *fds, int count){
+    union {
+        char buffer[CMSG_SPACE(PASSED_FD_LIMIT * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec part = {data, size};
+    struct msghdr message = {.msg_iov = &part, .msg_iovlen = 1, .msg_control = control.buffer, .msg_controllen = CMSG_SPACE(count * sizeof(int))};
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(count * sizeof(int));
+    memcpy(CMSG_DATA(header), fds, count * sizeof(int));
+    ssize_t n;
+    while((n = sendmsg(socket, &message, MSG_NOSIGNAL)) == -1 && errno == EINTR);
+    if(n == -1)
+        return -1;
+    //Sends the rest of the data if the socket took only part of it.
+    return (size_t)n < size ? write_all(socket, (char *)data + n, size - n) : 0;
 }
 
-//Executes a list of arguments.
-int execute(char **args){
-    char *first[MAX_SIZE], *second[MAX_SIZE];
-    int choice;
-    //Executes pipe commands.
-    if(is_pipe(args,first,second) != 0) {
-        return execute_pipe(first, second);
+//Receives a message with descriptors attached (SCM_RIGHTS, at most 'count' of them), returning the number of descriptors received (-1 on error).
+int receive_fds(int socket, void *data, size_t size, int *fds, int count){
+    union {
+        char buffer[CMSG_SPACE(PASSED_FD_LIMIT * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct iovec part = {data, size};
+    struct msghdr message = {.msg_iov = &part, .msg_iovlen = 1, .msg_control = control.buffer, .msg_controllen = CMSG_SPACE(count * sizeof(int))};
+    ssize_t n;
+    while((n = recvmsg(socket, &message, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR);
+    if(n <= 0)
+        return -1;
+    int received = 0;
+    for(struct cmsghdr *header = CMSG_FIRSTHDR(&message); header != NULL; header = CMSG_NXTHDR(&message, header)){
+        if(header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS){
+            received = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(header), received * sizeof(int));
+        }
     }
-    //Executes redirection commands.
-    if((choice = is_redirect(args,first,second)) != 0){
-        return execute_redirect(first,second,choice);
+    if((size_t)n < size && read_all(socket, (char *)data + n, size - n) == -1)
+        return -1;
+    return received;
+}
+
+/* ---------------------- ZYGOTE ---------------------- */
+
+//Runs the zygote ('eggshell --zygote fd', started by start_zygote()) - it launches programs for the shell at the other end of the socket 'fd',
+//and sends back their PIDs and every change in their state, until the shell closes the socket.
+int run_zygote(int fd){
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    //Leaves CTRL-C and CTRL-Z to the programs, like the shell does.
+    for(int i=0;i<sizeof(JOB_SIGNALS)/sizeof(int);i++)
+        signal(JOB_SIGNALS[i], SIG_IGN);
+    //Hears about its children through a descriptor, so one poll() waits for them and for the shell.
+    sigset_t children;
+    sigemptyset(&children);
+    sigaddset(&children, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &children, NULL);
+    struct pollfd events[] = {{.fd = fd, .events = POLLIN}, {.fd = signalfd(-1, &children, SFD_CLOEXEC), .events = POLLIN}};
+    char *text = malloc(ZYGOTE_TEXT_LIMIT);
+    while(true){
+        if(poll(events, 2, -1) == -1){
+            if(errno == EINTR)
+                continue;
+            perror("Error -- poll()");
+            free(text);
+            return 1;
+        }
+        if(events[1].revents & POLLIN){
+            struct signalfd_siginfo info;
+            read(events[1].fd, &info, sizeof(info));
+            ZYGOTE_MESSAGE message = {.launched = false};
+            while((message.pid = waitpid(-1, &message.status, WNOHANG | WUNTRACED | WCONTINUED)) > 0)
+                send(fd, &message, sizeof(message), MSG_NOSIGNAL);
+        }
+        if(events[0].revents != 0){
+            ZYGOTE_REQUEST request;
+            int fds[3];
+            int received = receive_fds(fd, &request, sizeof(request), fds, 3);
+            //Exits with the shell.
+            if(received == -1){
+                free(text);
+                return 0;
+            }
+            ssize_t n = recv(fd, text, ZYGOTE_TEXT_LIMIT, 0);
+            ZYGOTE_MESSAGE message = {.launched = true, .pid = -1, .status = EPROTO};
+            if(received == 3 && n > 0 && n == request.length && text[n - 1] == '\0'){
+                message.pid = zygote_fork(&request, text, fds, &children);
+                message.status = errno;
+            }
+            for(int i=0;i<received;i++)
+                close(fds[i]);
+            send(fd, &message, sizeof(message), MSG_NOSIGNAL);
+        }
     }
-    //Executes variable assignment.
-    if(is_var_assignment(args[0]) != 0){
-        return 1;
+}
+
+//Forks and executes a program in the zygote, returning its PID (-1 with errno set if it could not be launched).
+pid_t zygote_fork(ZYGOTE_REQUEST *request, char *text, int *fds, sigset_t *children){
+    //Splits the path, the arguments and the environment.
+    char **words = malloc((request->arg_count + request->env_count + 2) * sizeof(char *)), *path = text;
+    char **args = words, **env = words + request->arg_count + 1;
+    text += strlen(text) + 1;
+    for(int i=0;i<request->arg_count;i++, text += strlen(text) + 1)
+        args[i] = text;
+    args[request->arg_count] = NULL;
+    for(int i=0;i<request->env_count;i++, text += strlen(text) + 1)
+        env[i] = text;
+    env[request->env_count] = NULL;
+    //Fails before forking if the program is gone, so the shell can search PATH again.
+    pid_t pid = -1;
+    if(access(path, X_OK) == 0 && (pid = fork()) == 0){
+        if(request->pgid != -1)
+            setpgid(0, request->pgid);
+        for(int i=0;i<sizeof(JOB_SIGNALS)/sizeof(int);i++)
+            signal(JOB_SIGNALS[i], SIG_DFL);
+        sigprocmask(SIG_UNBLOCK, children, NULL);
+        for(int i=0;i<3;i++)
+            dup2(fds[i], i);
+        execve(path, args, env);
+        perror("Error - execve()");
+        _exit(127);
     }
-    //Executes internal commands.
-    for (int i = 0; i < sizeof(commands_names) / sizeof(char *); i++) {
-        //If the name is one of the in-built function names, executes that function.
-        if (strcmp(args[0], commands_names[i]) == 0)
-            return (*commands[i])(args);
+    //Also sets the group here, so it exists before the shell gives it the terminal.
+    if(pid > 0 && request->pgid != -1)
+        setpgid(pid, request->pgid == 0 ? pid : request->pgid);
+    free(words);
+    return pid;
+}
+
+//Returns whether external programs are launched by the zygote (LAUNCHER=zygote), starting it if it is not running.
+bool use_zygote(){
+    char *launcher = return_var_value("LAUNCHER");
+    if(launcher == NULL || strcmp(launcher, "zygote") != 0)
+        return false;
+    //A forked child of the shell starts a zygote of its own, leaving the shell's one alone.
+    if(zygote.owner != getpid()){
+        if(zygote.socket != -1)
+            close(zygote.socket);
+        zygote.socket = -1;
+        zygote.pid = 0;
+        zygote.owner = getpid();
     }
-    //Executes external commands.
-    launch(args);
-    return 1;
+    if(zygote.pid == 0)
+        start_zygote();
+    return zygote.socket != -1;
 }
 
-//Signal Handling function.
-void signals (int signal){
-    switch(signal) {
-        //If CTR-C is caught, terminate process.
-        case SIGINT:
-            printf("Signal %d caught.\n", signal);
-            exit(0); //Exits process.
-        //If CRT-Z is caught.
-        case SIGSTOP:
-            printf("Signal %d caught.\n", signal);
-            break;
-        default:
-            printf("Error - caught wrong signal.\n");
+//Starts the zygote - the shell's program started again with '--zygote', rather than a fork of the shell, so it stays small however large the shell grows.
+void start_zygote(){
+    zygote.pid = -1;
+    int pair[2];
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) == -1){
+        perror("Error -- socketpair()");
+        return;
+    }
+    //Only the zygote's end stays open across exec.
+    fcntl(pair[1], F_SETFD, 0);
+    char fd[16];
+    sprintf(fd, "%d", pair[1]);
+    char *args[] = {"eggshell", "--zygote", fd, NULL};
+    pid_t pid;
+    int error = posix_spawn(&pid, "/proc/self/exe", NULL, NULL, args, envp);
+    close(pair[1]);
+    if(error != 0){
+        fprintf(stderr, "Error - posix_spawn(): %s\n", strerror(error));
+        close(pair[0]);
+        return;
+    }
+    //Messages from the zygote raise SIGCHLD like the shell's own children do, so waiting for a job wakes up for them too.
+    fcntl(pair[0], F_SETOWN, getpid());
+    fcntl(pair[0], F_SETSIG, SIGCHLD);
+    fcntl(pair[0], F_SETFL, O_ASYNC);
+    zygote.pid = pid;
+    zygote.socket = pair[0];
+}
+
+//Launches an external command through the zygote, like spawn_command() does with posix_spawn, returning its PID (or -1, or REDIRECT_FAILED).
+pid_t zygote_command(COMMAND *command, char **args, int in, int out, pid_t pgid){
+    int fds[] = {in != -1 ? in : STDIN_FILENO, out != -1 ? out : STDOUT_FILENO, STDERR_FILENO}, opened[] = {-1, -1};
+    if(command != NULL){
+        if(open_redirects(command, fds, opened) == 0)
+            return REDIRECT_FAILED;
+        args = build_args(command->words, command->word_count, command->args, &command->expansion);
+    }
+    pid_t pid = -1;
+    char *path = find_command(args[0]);
+    if(path != NULL){
+        pid = zygote_launch(path, args, fds, pgid);
+        //Searches PATH again if the hashed program was moved or deleted.
+        if(pid == -1 && errno == ENOENT && strchr(args[0], '/') == NULL){
+            clear_command_hash();
+            if((path = find_command(args[0])) != NULL)
+                pid = zygote_launch(path, args, fds, pgid);
+        }
+    }
+    if(path == NULL)
+        fprintf(stderr, "Error - %s: command not found.\n", args[0]);
+    else if(pid == -1)
+        fprintf(stderr, "Error - zygote: %s\n", strerror(errno));
+    for(int i=0;i<2;i++){
+        if(opened[i] != -1)
+            close(opened[i]);
+    }
+    return pid;
+}
+
+//Sends a launch to the zygote and waits for its answer, returning the PID of the program (-1 with errno set if it could not be launched).
+pid_t zygote_launch(char *path, char **args, int *fds, pid_t pgid){
+    ZYGOTE_REQUEST request = {.pgid = pgid};
+    size_t length = strlen(path) + 1;
+    for(; args[request.arg_count] != NULL; request.arg_count++)
+        length += strlen(args[request.arg_count]) + 1;
+    for(; envp[request.env_count] != NULL; request.env_count++)
+        length += strlen(envp[request.env_count]) + 1;
+    if(length > ZYGOTE_TEXT_LIMIT){
+        errno = E2BIG;
+        return -1;
+    }
+    if(length > zygote.capacity){
+        zygote.capacity = length;
+        zygote.text = realloc(zygote.text, length);
+    }
+    char *end = stpcpy(zygote.text, path) + 1;
+    for(int i=0;i<request.arg_count;i++)
+        end = stpcpy(end, args[i]) + 1;
+    for(int i=0;i<request.env_count;i++)
+        end = stpcpy(end, envp[i]) + 1;
+    request.length = length;
+    fflush(stdout);
+    PROCESS_COUNT++;
+    if(send_fds(zygote.socket, &request, sizeof(request), fds, 3) == -1 || send(zygote.socket, zygote.text, length, MSG_NOSIGNAL) == -1){
+        lose_zygote();
+        errno = ECHILD;
+        return -1;
+    }
+    //Waits for the PID, recording the changes of the other programs the zygote reports meanwhile.
+    ZYGOTE_MESSAGE message;
+    while(read_zygote(&message, true)){
+        if(message.launched){
+            errno = message.status;
+            return message.pid;
+        }
+        update_job(message.pid, message.status);
+    }
+    errno = ECHILD;
+    return -1;
+}
+
+//Reads a message from the zygote, returning false if there is none (without waiting for one unless 'wait' is set) or the zygote stopped.
+bool read_zygote(ZYGOTE_MESSAGE *message, bool wait){
+    if(zygote.socket == -1 || zygote.owner != getpid())
+        return false;
+    ssize_t n;
+    while((n = recv(zygote.socket, message, sizeof(*message), wait ? 0 : MSG_DONTWAIT)) == -1 && errno == EINTR);
+    if(n == sizeof(*message))
+        return true;
+    if(n != -1 || errno != EAGAIN)
+        lose_zygote();
+    return false;
+}
+
+//Forgets a zygote that stopped (a new one is started for the next program). The programs it launched can no longer be waited for,
+//so they count as killed.
+void lose_zygote(){
+    close(zygote.socket);
+    zygote.socket = -1;
+    zygote.pid = 0;
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block, &old);
+    //Records the shell's own children first, so only the processes that are not its children are left.
+    reap_children();
+    for(int i=0;i<JOB_SIZE;i++){
+        JOB *job = job_table[i];
+        for(int p=0;job->used && p<job->count;p++){
+            siginfo_t info;
+            if(job->statuses[p] == -1 && job->pids[p] != -1 && waitid(P_PID, job->pids[p], &info, WEXITED | WNOHANG | WNOWAIT) == -1 && errno == ECHILD)
+                update_job(job->pids[p], SIGKILL);
+        }
+    }
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+/* ----------------------- JOBS ----------------------- */
+
+//Installs the SIGCHLD handler and, if the shell is interactive, puts it in its own process group in charge of the terminal.
+void init_jobs(){
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sigchld_handler;
+    sigemptyset(&action.sa_mask);
+    //Restarts interrupted reads, so a job finishing does not end the input.
+    action.sa_flags = SA_RESTART;
+    if(sigaction(SIGCHLD, &action, NULL) == -1)
+        perror("Error -- sigaction()");
+    JOB_CONTROL = INTERACTIVE && tcgetpgrp(STDIN_FILENO) != -1;
+    if(!JOB_CONTROL)
+        return;
+    //Waits until the shell is in the foreground.
+    while(tcgetpgrp(STDIN_FILENO) != (SHELL_PGID = getpgrp()))
+        kill(-SHELL_PGID, SIGTTIN);
+    //Leaves CTRL-C and CTRL-Z to the foreground job.
+    for(int i=0;i<sizeof(JOB_SIGNALS)/sizeof(int);i++)
+        signal(JOB_SIGNALS[i], SIG_IGN);
+    //Takes the terminal in a process group of its own.
+    setpgid(0, 0);
+    SHELL_PGID = getpgrp();
+    tcsetpgrp(STDIN_FILENO, SHELL_PGID);
+}
+
+//Reaps every child that exited, stopped or continued, leaving the changes for reap_children() to record.
+void sigchld_handler(int signal){
+    int saved_errno = errno, status;
+    pid_t pid;
+    while(REAPED_COUNT < REAP_SIZE && (pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0){
+        reaped[REAPED_COUNT].pid = pid;
+        reaped[REAPED_COUNT].status = status;
+        REAPED_COUNT++;
+    }
+    errno = saved_errno;
+}
+
+//Records the changes reaped by the SIGCHLD handler (and any it had no room for) in the job table.
+void reap_children(){
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block, &old);
+    for(int i=0;i<REAPED_COUNT;i++)
+        update_job(reaped[i].pid, reaped[i].status);
+    REAPED_COUNT = 0;
+    int status;
+    pid_t pid;
+    while((pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0)
+        update_job(pid, status);
+    //And the changes of the programs the zygote launched.
+    ZYGOTE_MESSAGE message;
+    while(read_zygote(&message, false))
+        update_job(message.pid, message.status);
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+//Records a change in the state of a process in the job it belongs to.
+void update_job(pid_t pid, int status){
+    for(int i=0;i<JOB_SIZE;i++){
+        JOB *job = job_table[i];
+        for(int p=0;job->used && p<job->count;p++){
+            if(job->pids[p] != pid || job->statuses[p] != -1)
+                continue;
+            if(WIFSTOPPED(status)){
+                job->stopped = true;
+                job->stop_status = status;
+            } else if(WIFCONTINUED(status)){
+                job->stopped = false;
+            } else {
+                job->statuses[p] = status;
+                job->running--;
+            }
+            return;
+        }
     }
 }
 
-//Returns the number of arguments inputted.
-int get_size_args(char **args){
+//Returns an unused entry of the job table for a job of 'count' processes, started from a pipeline or from arguments.
+//Entries are kept once allocated, so starting a job does not allocate memory.
+JOB *new_job(PIPELINE *pipeline, char **args, int count){
     int i = 0;
-    //Loops until the current argument is NULL, signifying the last argument.
-    while(args[i]!= NULL){
+    while(i < JOB_SIZE && job_table[i]->used)
         i++;
+    if(i == JOB_SIZE){
+        job_table = realloc(job_table, ++JOB_SIZE * sizeof(JOB *));
+        job_table[i] = calloc(1, sizeof(JOB));
     }
-    return i;
+    JOB *job = job_table[i];
+    if(count > job->capacity){
+        job->capacity = count;
+        job->pids = realloc(job->pids, count * sizeof(pid_t));
+        job->statuses = realloc(job->statuses, count * sizeof(int));
+    }
+    job->used = true;
+    job->id = i + 1;
+    job->pgid = 0;
+    job->count = 0;
+    job->running = 0;
+    job->stopped = false;
+    job->background = false;
+    job->pipeline = pipeline;
+    job->args = args;
+    return job;
 }
 
-//Splits the arguments array from a character.
-int split_args(char **args, char **first, char **second, char *c){
-    int n = get_size_args(args); //Determines size of arguments in args.
-    //Goes through every argument.
-    for(int i=0;i<n;i++){
-        //If the current argument is the character, split the 'args' array from this index.
-        if(strcmp(args[i],c) == 0){
-            //Copies the left half of the argument array.
-            memcpy(first, args, (i+1) * sizeof(char *));
-            first[i] = NULL;
-            //Copies the right half of the argument array.
-            memcpy(second, args+(i+1), ((n-i)+1) * sizeof(char *));
-            second[n] = NULL;
-            return 1;
-        } else
-            continue;
+//Adds a process to a job - the first one leads the job's process group.
+//Processes that could not be started (-1) count as a failed launch (exit code 127), and those whose redirections failed (REDIRECT_FAILED) exit with 1.
+void add_job_process(JOB *job, pid_t pid){
+    job->pids[job->count] = pid;
+    job->statuses[job->count++] = pid == -1 ? 127 << 8 : pid == REDIRECT_FAILED ? 1 << 8 : -1;
+    if(pid < 0)
+        return;
+    job->running++;
+    if(job->pgid == 0)
+        job->pgid = pid;
+}
+
+//Returns the process group the next process of a job joins (0 for a new one), or -1 without job control.
+pid_t job_pgid(JOB *job){
+    return JOB_CONTROL ? job->pgid : -1;
+}
+
+//Leaves a job running in the background (announcing it if the shell is interactive), or waits for it and sets the exit code.
+void run_job(JOB *job, bool background){
+    if(!background){
+        set_exitcode(wait_job(job, true));
+        return;
     }
-    return 0; //If the character wasn't one of the arguments returns 0.
+    job->background = true;
+    job_text(job);
+    if(JOB_CONTROL)
+        printf("[%d] %d\n", job->id, job->pids[job->count - 1]);
+    set_exitcode(0);
 }
 
-//Checks if there is redirection and returns argument split by redirect operator.
-int is_redirect(char **args, char **red1, char **red2){
-    //If a redirection operator is found, returns a value other than 0.
-    if (split_args(args,red1,red2, ">") != 0) {
-        return 1;
-    } else if (split_args(args,red1,red2, ">>") != 0) {
-        return 2;
-    } else if (split_args(args,red1,red2, "<") != 0) {
-        return 3;
-    } else if (split_args(args,red1,red2, "<<<") != 0) {
-        return 4;
-    } else
-        return 0; //Return 0 if none of the operators were found.
-}
-
-//Checks if there is a pipe and returns argument split into pipe sections.
-int is_pipe(char **args, char **pipe1, char **pipe2){
-    //If '|' is found, returns the left and right side of pipe arguments.
-    if(split_args(args,pipe1,pipe2,"|") != 0){
-        return 1;
-    } else
-        return 0; //Return 0 if '|' not found.
+//Waits until every process of a job finished or the job stopped, giving it the terminal if it runs in the foreground.
+//Returns the exit status of the job, freeing it if it finished.
+int wait_job(JOB *job, bool foreground){
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block, &old);
+    foreground = foreground && JOB_CONTROL && job->pgid != 0;
+    if(foreground)
+        tcsetpgrp(STDIN_FILENO, job->pgid);
+    reap_children();
+    while(job->running > 0){
+        if(job->stopped){
+            //Continues a job that used the terminal before it was given to it, or stops waiting.
+            int signal = WSTOPSIG(job->stop_status);
+            if(!foreground || (signal != SIGTTIN && signal != SIGTTOU))
+                break;
+            continue_job(job);
+        }
+        //Sleeps until a child changes state.
+        sigsuspend(&old);
+        reap_children();
+    }
+    if(foreground)
+        tcsetpgrp(STDIN_FILENO, SHELL_PGID);
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    //Keeps stopped jobs in the background.
+    if(job->running > 0){
+        if(!job->background){
+            job->background = true;
+            printf("\n[%d]+  Stopped\t\t%s\n", job->id, job_text(job));
+        }
+        return job->stop_status;
+    }
+    int status = job_status(job);
+    free_job(job);
+    return status;
 }
 
-//Executes the pipe commands.
-int execute_pipe(char **left, char **right){
-    int mypipe[2];
-    pid_t pid1, pid2;
-    //Creating the pipe.
-    if(pipe(mypipe) < 0){
-        perror("Error -- pipe()");
+//Returns the exit status of a finished job - of its last stage, or of its last failing stage with PIPEFAIL=1.
+int job_status(JOB *job){
+    char *pipefail = return_var_value("PIPEFAIL");
+    bool fail = pipefail != NULL && strcmp(pipefail, "1") == 0;
+    int status = 0;
+    for(int i=0;i<job->count;i++){
+        if(fail ? job->statuses[i] != 0 : i == job->count - 1)
+            status = job->statuses[i];
     }
-    //Creating a process.
-    pid1 = fork();
-    //If the fork failed.
-    if(pid1 == -1){
-        perror("Error -- fork()");
-    } else if (pid1 == 0) {
-        //Executes the left hand side of the commands.
-        //Sets stdout to the output side of the pipe (the writing end).
-        dup2(mypipe[1], STDOUT_FILENO);
-        //Closes input side of the pipe.
-        close(mypipe[0]);
-        //Executes the arguments.
-        execute(left);
-        exit(0);
+    return status;
+}
+
+//Continues every process of a stopped job.
+void continue_job(JOB *job){
+    if(JOB_CONTROL){
+        kill(-job->pgid, SIGCONT);
     } else {
-        //Creating another process.
-        pid2 = fork();
-        if(pid2 == -1){
-            perror("Error -- fork()");
-        } else if (pid2 == 0) {
-            //Executes the right hand side of the commands.
-            //Sets stdin to the input side of the pipe (the reading end).
-            dup2(mypipe[0], STDIN_FILENO);
-            //Closes output side of the pipe.
-            close(mypipe[1]);
-            //Executes the arguments.
-            execute(right);
-            exit(0);
-        } else {
-            //Closes input side of the pipe.
-            close(mypipe[0]);
-            //Closes output side of the pipe.
-            close(mypipe[1]);
-            //Waits for processes to finish.
-            wait(NULL);
-            wait(NULL);
+        for(int i=0;i<job->count;i++){
+            if(job->statuses[i] == -1)
+                kill(job->pids[i], SIGCONT);
         }
     }
-    return 1;
+    job->stopped = false;
 }
 
-int execute_redirect(char **left, char **right, int choice){
-    int status;
-    int out_redirection = 0, in_redirection = 0;
-    //Determines whether the arguments is an output redirection.
-    if(choice == 1 || choice == 2) {
-        out_redirection = 1;
-    }
-    //Determines whether the arguments is an input redirection.
-    if (choice == 3 || choice == 4){
-        in_redirection = 1;
+//Announces the background jobs that finished since the last prompt and forgets them (only if the shell is interactive).
+void notify_jobs(){
+    if(!JOB_CONTROL || JOB_SIZE == 0)
+        return;
+    reap_children();
+    for(int i=0;i<JOB_SIZE;i++){
+        JOB *job = job_table[i];
+        if(job->used && job->background && job->running == 0){
+            printf("[%d]  %-10s\t%s\n", job->id, job_state(job), job_text(job));
+            free_job(job);
+        }
     }
-    //Creating a process.
-    pid_t pid = fork();
-    if(pid == -1) {
-        perror("Error -- fork()");
-    } else if (pid == 0) {
-        //For output redirection.
-        if (out_redirection == 1) {
-            FILE *f;
-            //Opening an appropriate file depending on whether operator is '>' or '>>'.
-            if (choice == 1) {
-                if ((f = fopen(right[0], "w")) == NULL)
-                    perror("Error -- fopen()");
-            }
-            if (choice == 2){
-                if ((f = fopen(right[0], "a")) == NULL)
-                    perror("Error -- fopen()");
-            }
-            //Setting the stdout to the file.
-            dup2(fileno(f), STDOUT_FILENO);
-            //Closing the file.
-            fclose(f);
-            //Executing the arguments.
-            execute(left);
-            exit(1);
-        }
-        //For input redirection.
-        if (in_redirection == 1){
-            FILE *f;
-            //Opening an appropriate file depending on whether operator is '<' or '<<<'.
-            if(choice == 3){
-                if ((f = fopen(right[0], "r")) == NULL)
-                    perror("Error -- fopen()");
-            }
-            if(choice == 4){
-                int index = 0;
-                //Opening a temporary file ('HERE file') for the input.
-                if((f = tmpfile()) == NULL)
-                    perror("Error -- fopen()");
-                //Copies the right hand arguments into the file.
-                while(right[index]!= NULL){
-                    fputs(right[index], f);
-                    fputs(" ", f);
-                    index++;
-                }
-                fputs("\n", f);
-                rewind(f); //Returns to the start of the file.
-            }
-            //Setting stdin to the file.
-            dup2(fileno(f),STDIN_FILENO);
-            //Closing the file.
-            fclose(f);
-            //Executing the arguments.
-            execute(left);
-            exit(1);
-        }
-    //Parent process.
+}
+
+//Returns the state of a job as displayed by 'jobs'.
+char *job_state(JOB *job){
+    static char state[32];
+    if(job->running > 0)
+        return job->stopped ? "Stopped" : "Running";
+    int status = job->statuses[job->count - 1];
+    if(WIFSIGNALED(status))
+        sprintf(state, "Signal %d", WTERMSIG(status));
+    else if(WEXITSTATUS(status) != 0)
+        sprintf(state, "Exit %d", WEXITSTATUS(status));
+    else
+        return "Done";
+    return state;
+}
+
+//Returns the command line of a job, building it the first time from the pipeline (or arguments), which may be freed before the job finishes.
+char *job_text(JOB *job){
+    if(job->text != NULL)
+        return job->text;
+    char *operators[] = {[OUT_REDIRECT] = ">", [APPEND_REDIRECT] = ">>", [IN_REDIRECT] = "<", [HERE_STRING] = "<<<", [HERE_DOCUMENT] = "<<"};
+    size_t size;
+    FILE *text = open_memstream(&job->text, &size);
+    if(job->pipeline != NULL){
+        for(int c=0;c<job->pipeline->count;c++){
+            COMMAND *command = &job->pipeline->commands[c];
+            for(int w=0;w<command->word_count;w++)
+                fprintf(text, "%s%s", c > 0 && w == 0 ? " | " : w > 0 ? " " : "", command->words[w].text);
+            //Leaves out the body of 'HERE documents'.
+            for(int r=0;r<command->redirect_count;r++){
+                fprintf(text, " %s", operators[command->redirects[r].type]);
+                for(int w=0;command->redirects[r].type != HERE_DOCUMENT && w<command->redirects[r].word_count;w++)
+                    fprintf(text, " %s", command->redirects[r].words[w].text);
+            }
+        }
     } else {
-        //Waits for the child process and returns exit code if waitpid() is successful.
-        if(waitpid(pid, &status, WUNTRACED) == -1)
-            perror("Error - waitpid()");
-        else
-            set_exitcode(status); //Sets the exitcode environment variable.
+        for(int i=0;job->args[i]!=NULL;i++)
+            fprintf(text, "%s%s", i > 0 ? " " : "", job->args[i]);
     }
-    return 1;
+    fclose(text);
+    job->pipeline = NULL;
+    job->args = NULL;
+    return job->text;
 }
 
-//Reads a line from the console and returns it.
-char *read_line(){
-    char *line = NULL;
-    size_t size = 0;
-    getline(&line, &size, stdin);
-    return line;
-}
-
-//Tokenizes the line and returns an array of arguments.
-char **split_line(char *line){
-    int size = MAX_SIZE, index = 0;
-    //Allocates space for the array of arguments.
-    char **tokens = malloc(size * sizeof(char *));
-    char *token;
-    //Acquires the first token.
-    token = strtok(line, DELIMITERS);
-    //Splits string into tokens.
-    while(token != NULL) {
-        tokens[index] = token;
-        index++;
-        //Checks if more space needs to be allocated for the array of arguments.
-        if (index >= size) {
-            size += MAX_SIZE;
-            tokens = realloc(tokens, size * sizeof(char *));
-        }
-        //Acquires the next tokens.
-        token = strtok(NULL, DELIMITERS);
-    }
-    tokens[index] = NULL;
-    //Returns an array of tokens.
-    return tokens;
+//Returns the job named by '%n' or 'n' (or the newest background job if 'spec' is NULL), or NULL if there is none.
+JOB *find_job(char *spec){
+    JOB *found = NULL;
+    if(spec == NULL){
+        for(int i=0;i<JOB_SIZE;i++){
+            if(job_table[i]->used && job_table[i]->background)
+                found = job_table[i];
+        }
+        return found;
+    }
+    char *end;
+    long id = strtol(spec[0] == '%' ? spec + 1 : spec, &end, 10);
+    if(*end != '\0' || id < 1 || id > JOB_SIZE || !job_table[id - 1]->used || !job_table[id - 1]->background)
+        return NULL;
+    return job_table[id - 1];
 }
 
-/* --------------------- COMMANDS --------------------- */
+//Returns the background job a process belongs to, or NULL if there is none.
+JOB *find_pid_job(pid_t pid){
+    for(int i=0;i<JOB_SIZE;i++){
+        JOB *job = job_table[i];
+        for(int p=0;job->used && job->background && p<job->count;p++){
+            if(job->pids[p] == pid)
+                return job;
+        }
+    }
+    return NULL;
+}
 
-//The 'exit' internal command - Tells shell to exit.
-int exit_comm(char **args){
-    return 0;
+//Marks a job's entry in the job table as unused.
+void free_job(JOB *job){
+    job->used = false;
+    free(job->text);
+    job->text = NULL;
 }
 
-//The 'print' internal command - Displays variable values and strings.
-int print_comm(char **args){
-    //Executes if no arguments were inputted after 'print'.
-    if(args[1] == NULL){
-        fprintf(stderr,"Error -- No arguments inputted after the command \'print\'.\n");
-    } else {
-        int index = 1;
-        int n = get_size_args(args); //The number of arguments.
-        //If it starts and ends with " - variable insensitive.
-        if(args[1][0] == '\"' && args[n-1][strlen(args[n-1])-1] == '\"'){
-            //Executes if there is only one word in " " - to avoid errors.
-            if(n == 2) {
-                char *new_arg = args[index];
-                new_arg++; //Removes the first ".
-                new_arg[strlen(new_arg)-1] = '\0'; //Removes the second ".
-                printf("%s\n",new_arg); //Prints the string.
-                return 1;
+//Forgets every job, in a forked child (whose jobs are started by the child itself).
+void forget_jobs(){
+    for(int i=0;i<JOB_SIZE;i++)
+        free_job(job_table[i]);
+    REAPED_COUNT = 0;
+    JOB_CONTROL = false;
+}
+
+/* ------------------- COMMAND HASH ------------------- */
+
+//Returns the full path of an external command, searching PATH only the first time the command is used.
+char *find_command(char *name){
+    //Paths are used as they are.
+    if(strchr(name, '/') != NULL)
+        return name;
+    unsigned int hash = hash_name(name);
+    int mask = HASH_SIZE - 1;
+    if(HASH_SIZE != 0){
+        for(int slot = hash & mask; command_hash[slot].name != NULL; slot = (slot + 1) & mask){
+            HASHED_COMMAND *command = &command_hash[slot];
+            if(command->hash == hash && strcmp(name, command->name) == 0){
+                command->hits++;
+                return command->path;
             }
-            //Removes the " from first argument and prints it.
-            char *new_arg = args[index];
-            new_arg++, index++;
-            printf("%s ",new_arg);
-            //Prints the rest of the string until the last token.
-            while (args[index][strlen(args[index])-1] != '\"') {
-                printf("%s ", args[index]);
-                index++;
-            }
-            //Removes the " from last argument and prints it.
-            new_arg = args[index];
-            new_arg[strlen(new_arg)-1] = '\0';
-            printf("%s\n",new_arg);
-        } else {
-            //Prints all text after print - variable sensitive.
-            do {
-                //If the start of a token has $ check if it is a possible variable and replace it with the variable value.
-                if (args[index][0] == '$') {
-                    args[index] = set_var_value(args[index]);
-                }
-                printf("%s ", args[index]);
-                index++;
-            } while (args[index] != NULL);
-            printf("\n");
         }
     }
-    return 1;
+    char *path = search_path(name);
+    if(path == NULL)
+        return NULL; //Commands that were not found are not hashed.
+    //Keeps the table at most half full, re-inserting the commands when it grows.
+    if((HASH_COUNT + 1) * 2 > HASH_SIZE){
+        HASHED_COMMAND *old = command_hash;
+        int old_size = HASH_SIZE;
+        HASH_SIZE = HASH_SIZE == 0 ? 64 : HASH_SIZE * 2;
+        command_hash = calloc(HASH_SIZE, sizeof(HASHED_COMMAND));
+        for(int i=0;i<old_size;i++){
+            if(old[i].name == NULL)
+                continue;
+            int slot = old[i].hash & (HASH_SIZE - 1);
+            while(command_hash[slot].name != NULL)
+                slot = (slot + 1) & (HASH_SIZE - 1);
+            command_hash[slot] = old[i];
+        }
+        free(old);
+        mask = HASH_SIZE - 1;
+    }
+    int slot = hash & mask;
+    while(command_hash[slot].name != NULL)
+        slot = (slot + 1) & mask;
+    HASHED_COMMAND *command = &command_hash[slot];
+    command->name = strdup(name);
+    command->path = path;
+    command->hash = hash;
+    command->hits = 1;
+    HASH_COUNT++;
+    return path;
 }
 
-//The 'chdir' internal command - Changes directories.
-int chdir_comm(char **args){
-    //Executes if no arguments were inputted after 'chdir'.
-    if (args[1] == NULL){
-        fprintf(stderr,"Error -- No arguments inputted after the command \'chdir\'.\n");
-    } else {
-        //Changes the directory using the 'chdir()' function.
-        if (chdir(args[1]) == 0){
-            printf("Directory has been changed successfully.\n");
-            set_cwd(); //Updates the environment variable 'CWD'.
-        } else {
-            perror("Error -- chdir()");
-        }
+//Searches the directories in the PATH variable for an executable file, returning a new string with its path (or NULL).
+char *search_path(char *name){
+    char *dirs = return_var_value("PATH");
+    struct stat info;
+    if(dirs == NULL)
+        return NULL;
+    while(1){
+        //An empty directory in PATH is the current directory.
+        size_t length = strcspn(dirs, ":");
+        char *path = malloc(length + strlen(name) + 3);
+        if(length == 0)
+            sprintf(path, "./%s", name);
+        else
+            sprintf(path, "%.*s/%s", (int)length, dirs, name);
+        if(stat(path, &info) == 0 && S_ISREG(info.st_mode) && access(path, X_OK) == 0)
+            return path;
+        free(path);
+        if(dirs[length] == '\0')
+            return NULL;
+        dirs += length + 1;
     }
-    return 1;
 }
 
-//The 'all' internal command - Displays all variables and their values.
-int all_comm(char **args){
-    //Displays the environment variable and it's value.
-    for(int i=0;i<VAR_SIZE;i++){
-        printf("%s=%s\n", variables[i].name, variables[i].value);
+//Forgets every hashed command (e.g. when PATH changes).
+void clear_command_hash(){
+    for(int i=0;i<HASH_SIZE;i++){
+        free(command_hash[i].name);
+        free(command_hash[i].path);
     }
-    return 1;
+    free(command_hash);
+    command_hash = NULL;
+    HASH_SIZE = 0;
+    HASH_COUNT = 0;
 }
 
-//The 'source' internal command - Opens a text file, reads it and uses the input to execute commands.
-int source_comm(char **args){
-    //Executes if no arguments were inputted after 'source'.
-    if (args[1] == NULL){
-        fprintf(stderr,"Error -- No arguments inputted after the command \'source\'.\n");
-    } else {
-        FILE *f;
-        //Displays error if there are problems opening the file.
-        if((f = fopen(args[1], "r")) == NULL){
-            perror("Error -- fopen()");
-        }
-        //Scans each line of text file, parsing it and executing command.
-        char line[MAX_SIZE];
-        while(fgets(line,sizeof(line), f)){
-            //Splits line.
-            args = split_line(line);
-            //Executes command.
-            execute(args);
+/* ---------------------- ARENAS ---------------------- */
+
+//Returns 'size' bytes of arena memory.
+char *arena_alloc(ARENA *arena, size_t size){
+    //Starts a new block if the current one is full, doubling the block size each time.
+    if(arena->blocks == NULL || arena->blocks->used + size > arena->blocks->size){
+        size_t block_size = arena->blocks == NULL ? ARENA_BLOCK_SIZE : arena->blocks->size * 2;
+        while(block_size < size)
+            block_size *= 2;
+        ARENA_BLOCK *block = malloc(sizeof(ARENA_BLOCK) + block_size);
+        block->size = block_size;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    char *memory = arena->blocks->data + arena->blocks->used;
+    arena->blocks->used += size;
+    arena->used += size;
+    return memory;
+}
+
+//Returns 'size' bytes of arena memory aligned for any type.
+void *arena_new(ARENA *arena, size_t size){
+    size_t align = sizeof(void *) - 1;
+    if(arena->blocks != NULL && (arena->blocks->used & align) != 0){
+        size_t padding = sizeof(void *) - (arena->blocks->used & align);
+        //Skips the padding (unless a new block is needed anyway, which starts aligned).
+        if(arena->blocks->used + padding + size <= arena->blocks->size){
+            arena->blocks->used += padding;
+            arena->used += padding;
         }
-        //Closing the file.
-        fclose(f);
     }
-    return 1;
+    return arena_alloc(arena, size);
 }
 
-//Executes external commands, searching for a program and launching a process.
-int launch(char **args){
-    int status;
-    //Creating a process.
-    pid_t pid = fork();
-    if (pid == -1) {
-        perror("Error - fork()");
-    } else if (pid == 0) { //If PID is the child process.
-        //Signal handling for processes.
-        if(signal(SIGINT, signals) == SIG_ERR)
-            perror("Error - signal()");
-        //Creates an array of environment variables to be sent to the process.
-        char *env[] = {return_env_var("TERMINAL"),return_env_var("CWD"),NULL};
-        //Launches the process.
-        //execvpe(args[0],args,env) - does not work.
-        if (execvp(args[0], args) < 0) {
-            perror("Error - execvp()");
-        }
-    } else { //If PID is the parent process.
-        //Waits for the child process and returns exit code if waitpid() is successful.
-            if(waitpid(pid, &status, WUNTRACED) == -1)
-                perror("Error - waitpid()");
-            else
-                set_exitcode(status); //Sets the exitcode environment variable.
+//Copies a string into an arena.
+char *arena_strdup(ARENA *arena, char *string){
+    size_t size = strlen(string) + 1;
+    return memcpy(arena_alloc(arena, size), string, size);
+}
+
+//Empties an arena in one step, keeping its newest (largest) block for reuse unless it grew past ARENA_KEEP_LIMIT.
+void reset_arena(ARENA *arena){
+    ARENA_BLOCK *kept = arena->blocks;
+    if(kept != NULL && kept->size <= ARENA_KEEP_LIMIT){
+        arena->blocks = kept->next;
+        kept->next = NULL;
+        kept->used = 0;
+    } else {
+        kept = NULL;
     }
-    return 1;
+    free_arena(arena);
+    arena->blocks = kept;
+}
+
+//Frees every block of an arena.
+void free_arena(ARENA *arena){
+    while(arena->blocks != NULL){
+        ARENA_BLOCK *next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+    arena->used = 0;
+    arena->garbage = 0;
 }
 
 /* --------------------- VARIABLES -------------------- */
 
 //Defines environment variables for current shell.
 void define_var(){
+    //Imports the environment the shell was started with, which it exports again to the programs it launches.
+    for(char **entry = environ; *entry != NULL; entry++){
+        int length = name_length_of(*entry);
+        if(length == 0 || (*entry)[length] != '=')
+            continue;
+        char *name = strndup(*entry, length);
+        modify_var(name, *entry + length + 1);
+        export_var(name);
+        free(name);
+    }
     //Adding variables to the environment variables array.
     modify_var("SHELL", "/home/student/cps1012/bin/eggshell");
     modify_var("USER", getenv("USER"));
     modify_var("PROMPT", "> ");
     modify_var("PATH",getenv("PATH"));
     modify_var("HOME",getenv("HOME"));
-    set_terminal(); //Finds and sets the terminal value.
+    //The history file is in the home directory unless 'HISTFILE' is set.
+    char history_file[MAX_SIZE];
+    snprintf(history_file, sizeof(history_file), "%s/%s", return_var_value("HOME"), HISTORY_FILE);
+    modify_var("HISTFILE", getenv("HISTFILE") != NULL ? getenv("HISTFILE") : history_file);
+    set_exitcode(0);
+    //Finds and sets the terminal value (the terminal is only set up for an interactive shell).
+    if(INTERACTIVE)
+        set_terminal();
     set_cwd(); //Finds and sets the cwd value.
+    //Children see the shell's own variables too.
+    char *exported[] = {"SHELL", "USER", "PROMPT", "PATH", "HOME", "HISTFILE", "TERMINAL", "CWD", NULL};
+    for(int i=0;exported[i]!=NULL;i++){
+        if(find_var(exported[i]) != -1)
+            export_var(exported[i]);
+    }
+    //Starts the zygote before the first command, if the environment asks for it.
+    use_zygote();
 }
 
-//Returns the value of a variable.
-char *return_var_value(char *name){
-    //Accessing each environment variable.
+//Hashes a variable name (FNV-1a).
+unsigned int hash_name(char *name){
+    return hash_name_length(name, strlen(name));
+}
+
+//Hashes the first 'length' characters of a name.
+unsigned int hash_name_length(char *name, size_t length){
+    unsigned int hash = 2166136261u;
+    for(size_t i=0;i<length;i++){
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+//Returns the index of a variable in 'variables', or -1 if it does not exist.
+int find_var(char *name){
+    return find_var_length(name, strlen(name));
+}
+
+//Returns the index of the variable named by the first 'length' characters of 'name', so names can be looked up inside a word.
+int find_var_length(char *name, size_t length){
+    if(VAR_INDEX_SIZE == 0)
+        return -1;
+    unsigned int hash = hash_name_length(name, length);
+    int mask = VAR_INDEX_SIZE - 1;
+    //Probes the slots after the home slot until an empty slot is reached.
+    for(int slot = hash & mask; var_index[slot] != -1; slot = (slot + 1) & mask){
+        VARIABLE *var = &variables[var_index[slot]];
+        //Compares the cached hashes first, so strcmp only runs on a likely match.
+        if(var->hash == hash && strncmp(name, var->name, length) == 0 && var->name[length] == '\0')
+            return var_index[slot];
+    }
+    return -1;
+}
+
+//Rebuilds the hash index with 'size' slots, dropping deleted variables from the array.
+void resize_var_index(int size){
+    int live = 0;
+    //Moves the live variables to the front of the array, keeping their order.
     for(int i=0;i<VAR_SIZE;i++){
-        //If the current environment variable has the same name, return its value.
-        if(strcmp(name,variables[i].name) == 0) {
-            return variables[i].value;
-        }
+        if(variables[i].name != NULL)
+            variables[live++] = variables[i];
     }
-    return 0;
+    VAR_SIZE = live;
+    free(var_index);
+    var_index = malloc(size * sizeof(int));
+    memset(var_index, -1, size * sizeof(int));
+    VAR_INDEX_SIZE = size;
+    //Re-inserts every variable using its cached hash.
+    for(int i=0;i<VAR_SIZE;i++){
+        int slot = variables[i].hash & (size - 1);
+        while(var_index[slot] != -1)
+            slot = (slot + 1) & (size - 1);
+        var_index[slot] = i;
+    }
+}
+
+//Returns the value of a variable (valid until the variable store is next modified).
+char *return_var_value(char *name){
+    int i = find_var(name);
+    return i == -1 ? 0 : variables[i].value;
 }
 
 //Re-assigns a value to an environment variable or creates a new one.
 int modify_var(char *name, char *value){
-    //If no variables were inputted yet, allocate memory for one.
-    if(VAR_SIZE == 0){
-        VAR_SIZE++;
-        //Allocating memory for one variable.
-        variables = calloc((size_t)VAR_SIZE, sizeof(VARIABLE));
-        //Copying the arguments into the new array element.
-        strcpy(variables[VAR_SIZE-1].name, name);
-        strcpy(variables[VAR_SIZE-1].value, value);
-        return 1;
+    //Unset values (e.g. from getenv()) are stored as empty strings.
+    if(value == NULL)
+        value = "";
+    int size = strlen(value) + 1;
+    //Changing PATH may change where commands are found.
+    if(strcmp(name, "PATH") == 0){
+        clear_command_hash();
+        refresh_catalog(value);
     }
+    int i = find_var(name);
     //If the variable exists, replace it's contents.
-    for(int i=0;i<VAR_SIZE;i++) {
-        //If the current variable has the same name as the argument.
-        if (strcmp(name, variables[i].name) == 0) {
-            //Replaces the variable value.
-            strcpy(variables[i].value, value);
-            return 1;
+    if(i != -1){
+        VARIABLE *var = &variables[i];
+        //Overwrites the old value in place if it fits, otherwise moves the value to new arena space.
+        if(size <= var->value_size){
+            memmove(var->value, value, size);
+        } else {
+            char *new_value = arena_alloc(&var_arena, size);
+            memcpy(new_value, value, size);
+            var_arena.garbage += var->value_size;
+            var->value = new_value;
+            var->value_size = size;
+            compact_arena();
         }
+        if(var->env_slot != -1)
+            update_env(i);
+        return 1;
+    }
+    //Keeps the index at most half full, so probe sequences stay short.
+    if((VAR_SIZE + 1) * 2 > VAR_INDEX_SIZE){
+        //Leaves the index at most a quarter full after the resize.
+        int index_size = 16;
+        while((VAR_COUNT + 1) * 4 > index_size)
+            index_size *= 2;
+        resize_var_index(index_size);
     }
-    //Else, creates a new variable.
+    //Grows the array geometrically when it is full.
+    if(VAR_SIZE == VAR_CAPACITY){
+        VAR_CAPACITY = VAR_CAPACITY == 0 ? 16 : VAR_CAPACITY * 2;
+        variables = realloc(variables, VAR_CAPACITY * sizeof(VARIABLE));
+    }
+    //Creates a new variable at the end of the array, storing the name and value next to each other in the arena.
+    VARIABLE *var = &variables[VAR_SIZE];
+    int name_size = strlen(name) + 1;
+    var->name = arena_alloc(&var_arena, name_size + size);
+    memcpy(var->name, name, name_size);
+    var->value = var->name + name_size;
+    memcpy(var->value, value, size);
+    var->value_size = size;
+    var->hash = hash_name(name);
+    var->env_slot = -1;
+    //Inserts the variable into the first empty slot of its probe sequence.
+    int slot = var->hash & (VAR_INDEX_SIZE - 1);
+    while(var_index[slot] != -1)
+        slot = (slot + 1) & (VAR_INDEX_SIZE - 1);
+    var_index[slot] = VAR_SIZE;
     VAR_SIZE++;
-    //Allocating memory for a new variable.
-    variables = realloc(variables,(VAR_SIZE)*sizeof(VARIABLE));
-    //Copying the arguments into the new array element.
-    strcpy(variables[VAR_SIZE-1].name, name);
-    strcpy(variables[VAR_SIZE-1].value, value);
+    VAR_COUNT++;
+    return 1;
+}
+
+//Deletes a variable, returning 0 if it does not exist.
+int delete_var(char *name){
+    if(VAR_INDEX_SIZE == 0)
+        return 0;
+    unsigned int hash = hash_name(name);
+    int mask = VAR_INDEX_SIZE - 1;
+    int slot = hash & mask;
+    //Finds the slot pointing to the variable.
+    while(var_index[slot] != -1){
+        VARIABLE *var = &variables[var_index[slot]];
+        if(var->hash == hash && strcmp(name, var->name) == 0)
+            break;
+        slot = (slot + 1) & mask;
+    }
+    if(var_index[slot] == -1)
+        return 0;
+    if(strcmp(name, "PATH") == 0){
+        clear_command_hash();
+        refresh_catalog("");
+    }
+    if(variables[var_index[slot]].env_slot != -1)
+        unexport_var(var_index[slot]);
+    //Deletes the variable, leaving a hole in the array that the next resize removes.
+    VARIABLE *var = &variables[var_index[slot]];
+    var_arena.garbage += strlen(var->name) + 1 + var->value_size;
+    var->name = NULL;
+    var->value = NULL;
+    VAR_COUNT--;
+    //Shifts back the following slots of the cluster, so no probe sequence is broken.
+    int hole = slot;
+    for(int next = (slot + 1) & mask; var_index[next] != -1; next = (next + 1) & mask){
+        int home = variables[var_index[next]].hash & mask;
+        //Moves the entry if the hole lies between its home slot and its current slot.
+        if(((next - home) & mask) >= ((next - hole) & mask)){
+            var_index[hole] = var_index[next];
+            hole = next;
+        }
+    }
+    var_index[hole] = -1;
+    compact_arena();
     return 1;
 }
 
+//Copies the live names and values into a new arena once most of the old one is garbage.
+void compact_arena(){
+    if(var_arena.garbage < ARENA_BLOCK_SIZE || var_arena.garbage < var_arena.used - var_arena.garbage)
+        return;
+    ARENA old = var_arena;
+    size_t live = var_arena.used - var_arena.garbage;
+    //Sizes the first block of the new arena to hold all the live strings.
+    memset(&var_arena, 0, sizeof(ARENA));
+    if(live > 0) {
+        arena_alloc(&var_arena, live);
+        var_arena.blocks->used = 0;
+        var_arena.used = 0;
+    }
+    for(int i=0;i<VAR_SIZE;i++){
+        VARIABLE *var = &variables[i];
+        if(var->name == NULL)
+            continue;
+        //Copies the name and the value, keeping the value's spare capacity.
+        int name_size = strlen(var->name) + 1;
+        char *name = arena_alloc(&var_arena, name_size + var->value_size);
+        memcpy(name, var->name, name_size);
+        memcpy(name + name_size, var->value, var->value_size);
+        var->name = name;
+        var->value = name + name_size;
+    }
+    free_arena(&old);
+}
+
+//Returns the length of the name in a 'NAME=VALUE' word, or 0 if the word is not a variable assignment.
+int assignment_name_length(char *arg){
+    int i = name_length_of(arg);
+    return (i > 0 && arg[i] == '=') ? i : 0;
+}
+
+//Returns the length of the variable name at the start of 'text' (0 if it does not start with one).
+int name_length_of(char *text){
+    int i = 0;
+    //A name starts with a letter or '_' and continues with letters, digits or '_'.
+    while(text[i] == '_' || (i == 0 ? isalpha(text[i]) : isalnum(text[i])))
+        i++;
+    return i;
+}
+
 //Checks if there is an variable assignment - and modifies the environment variable accordingly.
 int is_var_assignment(char *arg){
-    //If there is an '=' in the string.
-    if(strstr(arg, "=") != NULL){
-        //Replace environment variables with their values if found.
-        arg = set_var_value(arg);
-        char *token;
-        //Allocates memory for two tokens.
-        char **tokens = malloc(2 * sizeof(char *));
-        int index = 0;
-        //Extracts the first token.
-        token = strtok(arg, "=");
-        while(token != NULL) {
-            tokens[index] = token;
-            index++;
-            //If there are more than two tokens, it is not a variable assignment.
-            if(index > 2){
-                return 0;
-            }
-            //Extracts the next tokens.
-            token = strtok(NULL, "=");
+    int length = assignment_name_length(arg);
+    if(length == 0)
+        return 0; //If it is not a variable assignment.
+    //Splits the argument (whose variables were already expanded) on the first '=', ending the name in place rather than copying it.
+    arg[length] = '\0';
+    assign_var(arg, arg + length + 1);
+    arg[length] = '=';
+    return 1;
+}
+
+//Sets a variable - the local variable with that name if a running function declared one, otherwise the shell variable.
+void assign_var(char *name, char *value){
+    LOCAL *local = FRAMES == NULL ? NULL : find_local(name, strlen(name));
+    if(local != NULL)
+        set_local(local, value);
+    else
+        modify_var(name, value);
+}
+
+//Returns the value of the variable named by the first 'length' characters of 'name', or NULL if it is not set.
+//Inside a function, this is a positional parameter ('1', '2'...), '#', '@' or '*', or a local variable of the function or of its callers, before the shell variables.
+char *lookup_var(char *name, size_t length){
+    if(isdigit(*name)){
+        int n = 0;
+        for(size_t i=0;i<length;i++){
+            if(!isdigit(name[i]))
+                return NULL;
+            n = n * 10 + name[i] - '0';
         }
-        //Call function to add a new environment variable or replace its value.
-        modify_var(tokens[0],tokens[1]);
-        return 1;
+        return (FRAMES == NULL || n == 0 || n > FRAMES->count) ? NULL : FRAMES->args[n];
     }
-    return 0; //If it is not a variable assignment.
+    if(length == 1 && *name == '#')
+        return FRAMES == NULL ? "0" : FRAMES->count_text;
+    if(length == 1 && (*name == '@' || *name == '*'))
+        return FRAMES == NULL ? NULL : FRAMES->all;
+    LOCAL *local = FRAMES == NULL ? NULL : find_local(name, length);
+    if(local != NULL)
+        return local->value;
+    int i = find_var_length(name, length);
+    return i == -1 ? NULL : variables[i].value;
 }
 
-//Replaces the $VAR with the value of the variable and returns argument.
-char *set_var_value(char *arg){
-    char *start;
-    static char new_arg[MAX_SIZE];
-    //Loops through all environment variable.
-    for(int i=0;i<VAR_SIZE;i++) {
-        //Adds the $ to the current variable name.
-        char temp[MAX_SIZE+1] = "$";
-        strcat(temp,variables[i].name);
-        //If the '$VAR' is found in argument, replace it with the value.
-        if (!(start = strstr(arg, temp))) {
-            continue;
-        } else {
-            //Replaces the location of the $VAR with it's value.
-            strncpy(new_arg, arg, start-arg);
-            new_arg[start-arg] = '\0';
-            sprintf(new_arg+(start-arg), "%s%s", variables[i].value, start+strlen(temp));
-            return new_arg; //Returns modified string.
+//Returns the local variable with a name, looking in the running function and then in its callers, or NULL if there is none.
+LOCAL *find_local(char *name, size_t length){
+    for(FRAME *frame = FRAMES; frame != NULL; frame = frame->previous){
+        for(int i=0;i<frame->local_count;i++){
+            if(strncmp(frame->locals[i].name, name, length) == 0 && frame->locals[i].name[length] == '\0')
+                return &frame->locals[i];
         }
     }
-    return arg; //Returns old string.
+    return NULL;
+}
+
+//Sets the value of a local variable, reusing its memory if the value fits.
+void set_local(LOCAL *local, char *value){
+    size_t size = strlen(value) + 1;
+    if(size > local->capacity){
+        local->capacity = size < 16 ? 16 : size;
+        local->value = realloc(local->value, local->capacity);
+    }
+    memcpy(local->value, value, size);
 }
 
 //Update exitcode variable based on input 'status'.
@@ -534,24 +4907,54 @@ void set_cwd(){
     modify_var("CWD",cwd);
 }
 
-//Finds the terminal variable and updates it's variable.
+//Finds the terminal variable and updates it's variable (left unset if the output is not a terminal).
 void set_terminal(){
-    char *terminal;
-    terminal = ttyname(STDOUT_FILENO);
-    modify_var("TERMINAL",terminal);
+    char *terminal = ttyname(STDOUT_FILENO);
+    if(terminal != NULL)
+        modify_var("TERMINAL",terminal);
 }
 
-//Sends an environment variable name and value as one string.
-char *return_env_var(char *name){
-    char *temp;
-    //Accessing each environment variable.
-    for(int i=0;i<VAR_SIZE;i++){
-        //If the variable name and argument name are the same.
-        if(strcmp(name,variables[i].name) == 0) {
-            temp = strcat(variables[i].name,"=");
-            //Returns a string in the form VAR=VALUE.
-            return strcat(temp,variables[i].value);
-        }
+//Exports a variable to the programs the shell launches (creating it empty if it is not set), returning 0 if it already was.
+int export_var(char *name){
+    int i = find_var(name);
+    if(i == -1){
+        modify_var(name, "");
+        i = find_var(name);
     }
-    return 0;
-}
\ No newline at end of file
+    if(variables[i].env_slot != -1)
+        return 0;
+    //Keeps room for the NULL ending the array.
+    if(ENV_COUNT + 2 > ENV_CAPACITY){
+        ENV_CAPACITY = ENV_CAPACITY == 0 ? 32 : ENV_CAPACITY * 2;
+        envp = realloc(envp, ENV_CAPACITY * sizeof(char *));
+    }
+    variables[i].env_slot = ENV_COUNT;
+    envp[ENV_COUNT++] = NULL;
+    envp[ENV_COUNT] = NULL;
+    update_env(i);
+    return 1;
+}
+
+//Rebuilds the 'NAME=VALUE' string of an exported variable after its value changed, reusing its memory if the value fits.
+void update_env(int i){
+    VARIABLE *var = &variables[i];
+    size_t name_length = strlen(var->name), value_length = strlen(var->value);
+    char *entry = realloc(envp[var->env_slot], name_length + value_length + 2);
+    memcpy(entry, var->name, name_length);
+    entry[name_length] = '=';
+    memcpy(entry + name_length + 1, var->value, value_length + 1);
+    envp[var->env_slot] = entry;
+}
+
+//Stops exporting a variable, moving the last string of 'envp' into its place.
+void unexport_var(int i){
+    int slot = variables[i].env_slot;
+    free(envp[slot]);
+    ENV_COUNT--;
+    if(slot != ENV_COUNT){
+        envp[slot] = envp[ENV_COUNT];
+        variables[find_var_length(envp[slot], strchr(envp[slot], '=') - envp[slot])].env_slot = slot;
+    }
+    envp[ENV_COUNT] = NULL;
+    variables[i].env_slot = -1;
+}
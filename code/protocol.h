@@ -0,0 +1,17 @@
+#ifndef OS_THING_PROTOCOL_H
+#define OS_THING_PROTOCOL_H
+
+#include <stdint.h>
+
+//The messages of 'eggshell --server' and its client (client.c), shared by both.
+
+#define SERVER_WORKERS 4 //Workers the server keeps waiting for requests, when no number is given.
+
+//The start of a request - the client sends it with its stdin, stdout and stderr attached (SCM_RIGHTS),
+//followed by the script to run and the directory to run it in. The server answers with the exit code of the script (an int32_t).
+typedef struct server_request {
+    uint32_t script_length;
+    uint32_t cwd_length;
+} SERVER_REQUEST;
+
+#endif //OS_THING_PROTOCOL_H